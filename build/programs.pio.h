@@ -0,0 +1,15 @@
+#pragma once
+#include <hardware/pio.h>
+static const pio_program_t pio_vga_program = {nullptr, 1, -1};
+static const pio_program_t pio_vga_pixels_program = {nullptr, 5, -1};
+static const pio_program_t pio_vga_hsync_program = {nullptr, 7, -1};
+static const pio_program_t pio_vga_vsync_program = {nullptr, 18, -1};
+pio_sm_config pio_vga_pixels_program_get_default_config(uint);
+pio_sm_config pio_vga_hsync_program_get_default_config(uint);
+pio_sm_config pio_vga_vsync_program_get_default_config(uint);
+static const pio_program_t pio_vga_nibbles_program = {nullptr, 7, -1};
+pio_sm_config pio_vga_nibbles_program_get_default_config(uint);
+#define pio_vga_pixels_offset_pixel 3u
+#define pio_vga_nibbles_offset_pixel 5u
+static const pio_program_t pio_tmds_program = {nullptr, 10, -1};
+pio_sm_config pio_tmds_program_get_default_config(uint);
@@ -0,0 +1,23 @@
+#include "agat7_font.h"
+
+namespace {
+
+constexpr Agat7GlyphMasks MakeGlyphMasks() {
+  Agat7GlyphMasks glyph_masks{};
+  for (int glyph = 0; glyph < (int) glyph_masks.size(); glyph++) {
+    for (int row = 0; row < (int) glyph_masks[glyph].size(); row++) {
+      const uint8_t char_line = agat7_font()[glyph][row];
+      for (int column = 0; column < kAgat7GlyphWidthPx; column++) {
+        if ((char_line & (1 << (7 - column))) != 0) { // Test the bit (MSb first).
+          glyph_masks[glyph][row] |=
+              (uint32_t) Vram::kPixelMask << (column * Vram::kBitsPerPixel);
+        }
+      }
+    }
+  }
+  return glyph_masks;
+}
+
+}  // namespace
+
+Agat7GlyphMasks agat7_glyph_masks = MakeGlyphMasks();
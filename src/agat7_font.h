@@ -1,8 +1,12 @@
+#pragma once
+
 // Agat-7 font data - 7x8 characters, ASCII 32-127.
 
 #include <array>
 #include <stdint.h>
 
+#include "vram.h"
+
 using Agat7Font = std::array<std::array<uint8_t, 8>, 96>;  // 8 lines, 96 chars.
 
 // NOTE: A consteval function is required to guarantee that the constant will not occupy memory.
@@ -982,3 +986,13 @@ consteval Agat7Font agat7_font() {
     },
   }};
 }
+
+constexpr int kAgat7GlyphWidthPx = 7;  // The font columns from the MSB which make the pixels.
+static_assert(kAgat7GlyphWidthPx * Vram::kBitsPerPixel <= 32);
+
+// The rows of the agat7_font() glyphs in the Vram pixel format, a word per row, with all bits of
+// the lit pixels set: the mask image of a character for Vram::FillMasked(), or, ANDed with the
+// replicated color, its pixels. Built at compile time; not const, so that it is copied to RAM
+// rather than read from the flash.
+using Agat7GlyphMasks = std::array<std::array<uint32_t, 8>, 96>;
+extern Agat7GlyphMasks agat7_glyph_masks;
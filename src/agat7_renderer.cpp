@@ -3,6 +3,9 @@
 #include "agat7_font.h"
 #include "debug.h"
 
+static_assert(Agat7Renderer::kCharWidth == kAgat7GlyphWidthPx);
+static_assert(sizeof(agat7_glyph_masks[0]) == Agat7Renderer::kCharHeight * sizeof(uint32_t));
+
 void Agat7Renderer::InitTextBuffer() {
   for (int row = 0; row < kTextHeight; row++) {
     for (int column = 0; column < kTextWidth; column++) {
@@ -12,29 +15,23 @@ void Agat7Renderer::InitTextBuffer() {
   }
 }
 
-void Agat7Renderer::RenderTextBuffer() {
+void Agat7Renderer::RenderTextBuffer(TextComposite text_composite) {
+  if (text_composite == TextComposite::kOpaque) {
+    vram_->FillRect(kTextAreaMargin, 0, kTextAreaWidthPx, kTextHeight * kCharHeight, Vram::kBlack);
+  }
   for (int text_y = 0; text_y < kTextHeight; text_y++) {
     for (int text_x = 0; text_x < kTextWidth; text_x++) {
       const uint8_t c = text_buffer_[text_y][text_x];
       if (!ASSERT_CMP(c, >=, 32) || !ASSERT_CMP(c, <=, 127)) {
         continue;
       }
-      static_assert(sizeof(agat7_font()) == (128 - 32) * kCharHeight);
 
       const int base_pixel_x = kTextAreaMargin + (text_x * kCharWidth);
       const int base_pixel_y = text_y * kCharHeight;
 
-      for (int row = 0; row < kCharHeight; row++) {
-        const uint8_t char_line = agat7_font()[c - 32][row];
-
-        for (int column = 0; column < kCharWidth; column++) {
-          if ((char_line & (1 << (7 - column))) != 0) { // Test the bit (MSb first).
-            const int screen_x = base_pixel_x + column;
-            const int screen_y = base_pixel_y + row;
-            vram_->SetPixel(screen_x, screen_y, text_color_[text_y][text_x]);
-          }
-        }
-      }
+      // The lit pixels get the color, and the others are left as is.
+      vram_->FillMasked(base_pixel_x, base_pixel_y, agat7_glyph_masks[c - 32].data(),
+          kCharWidth, kCharHeight, /*mask_stride*/ 1, text_color_[text_y][text_x]);
     }
   }
 }
@@ -84,11 +81,7 @@ void Agat7Renderer::DrawHorzLineMgr(int x_half, int y_half, int len_half, Vram::
     ) {
     return;
   }
-  const uint8_t byte = (color << 4) | color;
-  for (int byte_idx = x_half; byte_idx < x_half + len_half; ++byte_idx) {
-    vram_->LineBytes(y_half * 2)[byte_idx] = byte;  // Fill two consecutive pixels.
-    vram_->LineBytes(y_half * 2 + 1)[byte_idx] = byte;  // Fill two consecutive pixels.
-  }
+  vram_->FillRect(x_half * 2, y_half * 2, len_half * 2, 2, color);
 }
 
 void Agat7Renderer::DrawVertLineMgr(int x_half, int y_half, int len_half, Vram::Color color) {
@@ -100,10 +93,7 @@ void Agat7Renderer::DrawVertLineMgr(int x_half, int y_half, int len_half, Vram::
       || !ASSERT_CMP(y_half + len_half, <=, kGraphHeight / 2)) {
     return;
   }
-  const uint8_t byte = (color << 4) | color;
-  for (int y = y_half * 2; y < (y_half + len_half) * 2; ++y) {
-    vram_->LineBytes(y)[x_half] = byte;  // Fill two consecutive pixels.
-  }
+  vram_->FillRect(x_half * 2, y_half * 2, 2, len_half * 2, color);
 }
 
 void Agat7Renderer::PlotHgr(int x, int y, Vram::Color color) {
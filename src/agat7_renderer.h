@@ -58,9 +58,15 @@ class Agat7Renderer {
       int text_x, int text_y, const char* str, Vram::Color color = Vram::kGreen,
       PrintMode print_mode = PrintMode::kAssertNoRussian);
 
-  // Render the internal text mode buffer to Vram with the proper margins - only non-black pixels
-  // of the text layer are copied to Vram, black text pixels become effectively transparent.
-  void RenderTextBuffer();
+  enum class TextComposite{
+    kTransparent,  // Only non-black pixels of the text layer are copied to Vram; the default mode.
+    kOpaque,  // The text area is cleared to black first.
+  };
+
+  // Render the internal text mode buffer to Vram with the proper margins - with kTransparent,
+  // black text pixels become effectively transparent. Each glyph row is a couple of masked word
+  // operations on Vram, with the glyph masks pre-expanded from the font at compile time.
+  void RenderTextBuffer(TextComposite text_composite = TextComposite::kTransparent);
 
   // Draw a horizontal line 2 pixels thick; coords are specified in two-pixel units - MGR mode.
   void DrawHorzLineMgr(int x_half, int y_half, int len_half, Vram::Color color);
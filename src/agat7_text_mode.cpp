@@ -0,0 +1,122 @@
+#include "agat7_text_mode.h"
+
+#include <array>
+#include <string.h>
+
+#include "agat7_font.h"
+#include "debug.h"
+
+namespace {
+
+static_assert(Vram::kBitsPerPixel == 4 && Vram::kWidthPx == 256,
+    "The text mode lines are made for the Agat-7 Vram");
+
+constexpr int kCharWidth = kAgat7GlyphWidthPx;  // With 32 columns.
+constexpr int kNarrowCharWidth = 4;  // With 64 columns.
+constexpr int kMarginPx = (Vram::kWidthPx - 32 * kCharWidth) / 2;
+static_assert(sizeof(agat7_glyph_masks[0]) == Agat7TextMode::kCharHeight * sizeof(uint32_t));
+static_assert(kMarginPx * 4 % 32 == 0 && 32 * kCharWidth * 4 % 32 == 0);
+static_assert(64 * kNarrowCharWidth == Vram::kWidthPx);
+
+// Like agat7_glyph_masks, for the 64 columns: two font columns, from the MSB, make a pixel.
+using NarrowGlyphRows = std::array<std::array<uint16_t, Agat7TextMode::kCharHeight>, 96>;
+
+constexpr NarrowGlyphRows MakeNarrowGlyphRows() {
+  NarrowGlyphRows glyph_rows{};
+  for (int glyph = 0; glyph < (int) glyph_rows.size(); glyph++) {
+    for (int row = 0; row < Agat7TextMode::kCharHeight; row++) {
+      const uint8_t char_line = agat7_font()[glyph][row];
+      for (int x = 0; x < kNarrowCharWidth; x++) {
+        if (((char_line << (x * 2)) & 0xC0) != 0) {
+          glyph_rows[glyph][row] |= (uint16_t) (0xF << (x * 4));
+        }
+      }
+    }
+  }
+  return glyph_rows;
+}
+
+NarrowGlyphRows narrow_glyph_rows = MakeNarrowGlyphRows();  // In RAM, see agat7_glyph_masks.
+
+}  // namespace
+
+void Agat7TextMode::SetColumnCount(int column_count) {
+  if (!ASSERT(column_count == 32 || column_count == kMaxColumnCount,
+      "Unexpected column count %d", column_count)) {
+    return;
+  }
+  column_count_.store(column_count, std::memory_order_relaxed);
+}
+
+void Agat7TextMode::Clear(Vram::Color color) {
+  memset(chars_, ' ', sizeof(chars_));
+  for (auto& row_colors: colors_) {
+    for (auto& char_color: row_colors) {
+      char_color = color;
+    }
+  }
+}
+
+void Agat7TextMode::SetChar(int text_x, int text_y, uint8_t c, Vram::Color color) {
+  if (!ASSERT_CMP(c, >=, 32)
+      || !ASSERT_CMP(c, <=, 127)
+      || !ASSERT_CMP(text_x, >=, 0)
+      || !ASSERT_CMP(text_x, <, kMaxColumnCount)
+      || !ASSERT_CMP(text_y, >=, 0)
+      || !ASSERT_CMP(text_y, <, kRowCount)) {
+    return;
+  }
+  colors_[text_y][text_x] = color;
+  chars_[text_y][text_x] = c;
+}
+
+void Agat7TextMode::PrintAt(int text_x, int text_y, const char* str, Vram::Color color) {
+  if (!ASSERT_CMP(text_x + (int) strlen(str), <=, column_count())) {
+    return;
+  }
+  for (int column = text_x; *str != '\0'; ++column, ++str) {
+    SetChar(column, text_y, *str, color);
+  }
+}
+
+Span<const uint8_t> __not_in_flash_func(Agat7TextMode::LineBytes)(int y) {
+  if (!ASSERT_CMP(y, >=, 0) || !ASSERT_CMP(y, <, height())) {
+    y = 0;
+  }
+  const uint8_t* const chars = chars_[y / kCharHeight];
+  const Vram::Color* const colors = colors_[y / kCharHeight];
+  const int row = y % kCharHeight;
+  uint32_t* word_ptr = (uint32_t*) line_;
+
+  if (column_count() == kMaxColumnCount) {
+    // Two characters per word.
+    for (int i = 0; i < kMaxColumnCount; i += 2) {
+      const uint32_t pixels = narrow_glyph_rows[chars[i] - 32][row]
+          | ((uint32_t) narrow_glyph_rows[chars[i + 1] - 32][row] << 16);
+      *word_ptr++ = pixels
+          & ((Vram::Replicate(colors[i]) & 0xFFFF) | (Vram::Replicate(colors[i + 1]) << 16));
+    }
+    return {line_, Vram::kLineSize};
+  }
+
+  // The characters are shifted into a bit accumulator, which is flushed a word at a time.
+  for (int i = 0; i < kMarginPx * 4 / 32; ++i) {
+    *word_ptr++ = 0;
+  }
+  uint64_t bits = 0;
+  int bit_count = 0;
+  for (int i = 0; i < 32; ++i) {
+    bits |= (uint64_t) (agat7_glyph_masks[chars[i] - 32][row] & Vram::Replicate(colors[i]))
+        << bit_count;
+    bit_count += kCharWidth * 4;
+    if (bit_count >= 32) {
+      *word_ptr++ = (uint32_t) bits;
+      bits >>= 32;
+      bit_count -= 32;
+    }
+  }
+  for (int i = 0; i < kMarginPx * 4 / 32; ++i) {
+    *word_ptr++ = 0;
+  }
+  return {line_, Vram::kLineSize};
+}
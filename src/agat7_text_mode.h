@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include <pico.h>
+
+#include "span.h"
+#include "vram.h"
+
+// Agat-7 text mode: the lines are built from the text buffer and the font when the scanout asks
+// for them, like the character generator of the real machine does, instead of being rasterized
+// into Vram; see Config::kLineSource. So changing a character is a write of its byte, and a text
+// screen takes 4 KB instead of the Vram.
+//
+// The lines are in the Vram format, 256x256 pixels, so that the scanout converts them the same
+// way as Vram lines:
+// - 32 columns: 7x8 characters in the center, with the margins of Agat7Renderer.
+// - 64 columns: 4x8 characters filling the width; 4-bit pixels at this width cannot show the
+//     512-pixel raster of the real machine, so the glyphs are narrowed to 4 pixels by merging
+//     the pairs of font columns.
+//
+// The text can be changed at any time, e.g. from the main loop, and the next line asked for by the
+// scanout shows it. Only one line buffer is used, so LineBytes() must be called by a single
+// consumer, which is done with the span before the next call.
+class Agat7TextMode {
+ public:
+  static constexpr int kMaxColumnCount = 64;
+  static constexpr int kRowCount = 32;
+  static constexpr int kCharHeight = 8;
+
+  Agat7TextMode() { Clear(); }
+
+  int width_px() const { return Vram::kWidthPx; };
+  int height() const { return kRowCount * kCharHeight; }
+
+  // 32 or 64.
+  void SetColumnCount(int column_count);
+  int column_count() const { return column_count_.load(std::memory_order_relaxed); }
+
+  // Fills the whole buffer, including the columns not shown with 32 columns, with spaces.
+  void Clear(Vram::Color color = Vram::kWhite);
+
+  // The characters are 32..127; the font has Russian letters at 96..127.
+  void SetChar(int text_x, int text_y, uint8_t c, Vram::Color color);
+
+  // Prints the string at the given text coordinates, within the current column count.
+  void PrintAt(int text_x, int text_y, const char* str, Vram::Color color = Vram::kGreen);
+
+  // Generates the line from the text buffer; the span is valid until the next call.
+  Span<const uint8_t> LineBytes(int y);
+
+ private:
+  std::atomic<int> column_count_ = 32;
+  uint8_t chars_[kRowCount][kMaxColumnCount];
+  Vram::Color colors_[kRowCount][kMaxColumnCount];
+
+  alignas(4) uint8_t line_[Vram::kStride];
+};
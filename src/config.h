@@ -37,13 +37,121 @@ class Config {
   }
 
   //-----------------------------------------------------------------------------------------------
-  // Choose the video mode: -DMODE=agat7 or -DMODE=vga.
+  // Choose the video mode: -DMODE=agat7, -DMODE=vga, -DMODE=pal (interlaced 625/50, scanned out
+  // by the frame chain: needs -DTIMING=dma and -DAGAT7_SCANOUT=chain), -DMODE=cvbs (PAL composite
+  // video on the 8 output pins wired as a DAC, see the readme; needs -DTIMING=dma), or -DMODE=dvi
+  // (640x480 DVI for an HDMI input, the 8 output pins being 4 TMDS pairs; needs -DTIMING=dma).
   #if !defined(MODE)
     #define MODE agat7
   #endif
-  enum class Mode { agat7, vga };
+  enum class Mode { agat7, vga, pal, cvbs, dvi };
   static constexpr auto kMode = Mode::MODE;
 
+  //-----------------------------------------------------------------------------------------------
+  // Choose how -DMODE=pal maps Vram onto the 576 lines of the interlaced frame:
+  // - -DINTERLACE=weave: each Vram line is one frame line, so consecutive Vram lines alternate
+  //   between the fields - shows interlace flicker on thin horizontal details.
+  // - -DINTERLACE=pair: each Vram line is shown on both fields, on two adjacent frame lines -
+  //   shows whether the fields interleave evenly (line pairing).
+  #if !defined(INTERLACE)
+    #define INTERLACE weave
+  #endif
+  enum class Interlace { weave, pair };
+  static constexpr auto kInterlace = Interlace::INTERLACE;
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose how the Agat-7 scanout works:
+  // - -DAGAT7_SCANOUT=chain: Vram is pre-rendered into a buffer per line; the control DMA channel
+  //   walks a per-frame table of line buffers by itself, one IRQ per frame.
+  // - -DAGAT7_SCANOUT=irq: Vram is pre-rendered into a buffer per line; an IRQ on every line picks
+  //   the next line buffer.
+  // - -DAGAT7_SCANOUT=stream: like in the VGA mode, core 1 converts Vram lines just in time into a
+  //   small ring of line buffers, so Vram changes are shown immediately. Unverified on a board:
+  //   its core 1 load and line underruns are computed, not measured; with -DPROFILE=on, compare
+  //   "Line conversion (core 1)" with the line period of the "Main" DMA load, and check that
+  //   "Late lines" stays 0. Until then, chain stays the default.
+  #if !defined(AGAT7_SCANOUT)
+    #define AGAT7_SCANOUT chain
+  #endif
+  enum class Agat7Scanout { chain, irq, stream };
+  static constexpr auto kAgat7Scanout = Agat7Scanout::AGAT7_SCANOUT;
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose how the sync pulses and porches are generated:
+  // - -DTIMING=dma: they are stored in every DMA line buffer, and the PIO replays whole lines.
+  // - -DTIMING=pio: dedicated PIO state machines generate them from the video mode counters; the
+  //   DMA moves only the visible pixels, and the line buffers hold only the visible pixels. The
+  //   horizontal scale is applied by repeating each pixel in the PIO, so the porches and syncs
+  //   are timed at the native pixel clock, and the line buffers shrink by the scale.
+  #if !defined(TIMING)
+    #define TIMING dma
+  #endif
+  enum class Timing { dma, pio };
+  static constexpr auto kTiming = Timing::TIMING;
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose who turns the 4-bit Vram pixels into the RGB GPIO levels:
+  // - -DPIXEL_UNPACKING=cpu: the CPU, via the palette, into DMA line buffers of GPIO bytes.
+  // - -DPIXEL_UNPACKING=pio: the PIO, which outputs each Vram pixel as is to 4 GPIOs, in the order
+  //   of the Vram::Color bits: blue, green, red, bright; the DMA reads Vram lines directly. Needs
+  //   the board RGB outputs to be wired this way, and -DTIMING=pio.
+  #if !defined(PIXEL_UNPACKING)
+    #define PIXEL_UNPACKING cpu
+  #endif
+  enum class PixelUnpacking { cpu, pio };
+  static constexpr auto kPixelUnpacking = PixelUnpacking::PIXEL_UNPACKING;
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose the framebuffer:
+  // - -DFRAMEBUFFER=vram: the 4-bit Vram, converted to the GPIO levels as per -DPIXEL_UNPACKING.
+  // - -DFRAMEBUFFER=gpio: a GpioFramebuffer of one byte per pixel holding the levels of the R, G
+  //   and B pins (2 bits each, so 64 colors) as is, sized to the visible area of the mode; the
+  //   DMA feeds its lines straight to the PIO, with no conversion. Shows 64-color test patterns
+  //   instead of the Agat-7 picture; needs -DTIMING=pio and -DMODE=agat7 or -DMODE=vga.
+  #if !defined(FRAMEBUFFER)
+    #define FRAMEBUFFER vram
+  #endif
+  enum class Framebuffer { vram, gpio };
+  static constexpr auto kFramebuffer = Framebuffer::FRAMEBUFFER;
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose how -DMODE=vga applies the horizontal scale of 2 with -DTIMING=dma and
+  // -DPIXEL_UNPACKING=cpu:
+  // - -DPIXEL_DOUBLING=pio: the PIO clock is slowed down, and the line conversion emits each Vram
+  //   pixel once, via the palette.
+  // - -DPIXEL_DOUBLING=conversion: the line conversion emits each Vram pixel twice, a 32-bit word
+  //   per Vram byte via DoubledPalette, and the PIO runs at the native pixel clock, so the porches
+  //   and syncs get the native pixel precision. Its cycles per line have not been measured on a
+  //   board against pio yet (see "Line conversion (core 1)" with -DPROFILE=on).
+  #if !defined(PIXEL_DOUBLING)
+    #define PIXEL_DOUBLING pio
+  #endif
+  enum class PixelDoubling { pio, conversion };
+  static constexpr auto kPixelDoubling = PixelDoubling::PIXEL_DOUBLING;
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose how the VGA line conversion computes the DoubledPalette LUT addresses:
+  // -DLINE_CONVERSION=cpu or -DLINE_CONVERSION=interp (by the RP2040 hardware interpolators).
+  #if !defined(LINE_CONVERSION)
+    #define LINE_CONVERSION cpu
+  #endif
+  enum class LineConversion { cpu, interp };
+  static constexpr auto kLineConversion = LineConversion::LINE_CONVERSION;
+  static_assert(kLineConversion == LineConversion::cpu
+      || kPixelDoubling == PixelDoubling::conversion,
+      "The interpolators compute the DoubledPalette addresses");
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose what the scanout shows: -DLINE_SOURCE=vram, -DLINE_SOURCE=pattern (service test
+  // patterns computed per line, see LinePatterns), or -DLINE_SOURCE=text (the Agat-7 text mode of
+  // 32 or 64 columns, built per line by a character generator, see Agat7TextMode). Other than
+  // vram, needs a line ring scanout, i.e. -DMODE=vga or -DAGAT7_SCANOUT=stream.
+  #if !defined(LINE_SOURCE)
+    #define LINE_SOURCE vram
+  #endif
+  enum class LineSource { vram, pattern, text };
+  static constexpr auto kLineSource = LineSource::LINE_SOURCE;
+
   //-----------------------------------------------------------------------------------------------
   // Choose the sync polarity: -DSYNC=pos or -DSYNC=neg.
   #if !defined(SYNC)
@@ -58,6 +166,37 @@ class Config {
       (value == Sync::pos) ? "pos" :
       (/*compile-time error*/abort() /*operator comma*/, "Unexpected SYNC");
   }
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose the sync outputs:
+  // - -DSYNC_OUTPUT=hv: separate H-sync and V-sync; for SCART, they may be diode-ORed into a crude
+  //   composite sync, on which some TVs lose lock.
+  // - -DSYNC_OUTPUT=csync: the H-sync pin carries a proper composite sync with the PAL equalizing
+  //   and broad pulses during the vertical blanking; the V-sync pin is unchanged. The lines are
+  //   precomputed, so it costs no CPU time; needs -DTIMING=dma.
+  #if !defined(SYNC_OUTPUT)
+    #define SYNC_OUTPUT hv
+  #endif
+  enum class SyncOutput { hv, csync };
+  static constexpr auto kSyncOutput = SyncOutput::SYNC_OUTPUT;
+  static_assert(kSyncOutput == SyncOutput::hv || kTiming == Timing::dma,
+      "The composite sync is built into the DMA line buffers");
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose whether a second output runs alongside the main one:
+  // - -DSECOND_OUTPUT=none: only the main output.
+  // - -DSECOND_OUTPUT=agat7: with -DMODE=vga, the Agat-7 15 kHz frame of the same Vram is also
+  //   output on the second pin group (R, G, B and composite sync, see the readme), scanned out by
+  //   the frame chain on its own PIO state machine and DMA channels; needs -DTIMING=dma.
+  #if !defined(SECOND_OUTPUT)
+    #define SECOND_OUTPUT none
+  #endif
+  enum class SecondOutput { none, agat7 };
+  static constexpr auto kSecondOutput = SecondOutput::SECOND_OUTPUT;
+  static_assert(kSecondOutput == SecondOutput::none
+      || (kMode == Mode::vga && kTiming == Timing::dma),
+      "The second output runs alongside the VGA line ring scanout");
+
   //-----------------------------------------------------------------------------------------------
   // Choose whether an assertion failure must panic (flash the LED and hang): -DFAILURE=log or
   // -DFAILURE=panic.
@@ -74,4 +213,14 @@ class Config {
       (value == Failure::panic) ? "panic" :
       (/*compile-time error*/abort() /*operator comma*/, "Unexpected FAILURE");
   }
+
+  //-----------------------------------------------------------------------------------------------
+  // Choose whether the scanout code measures itself in CPU cycles and prints the stats every
+  // second, and whether the startup renders the Agat-7 text once more to time it:
+  // -DPROFILE=off or -DPROFILE=on.
+  #if !defined(PROFILE)
+    #define PROFILE off
+  #endif
+  enum class Profile { off, on };
+  static constexpr auto kProfile = Profile::PROFILE;
 };
@@ -0,0 +1,95 @@
+#include "cvbs_encoder.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include "debug.h"
+
+namespace {
+
+// Luma and chroma, in units of the white level above the blank level.
+struct Yuv {
+  float y;
+  float u;
+  float v;
+};
+
+Yuv ToYuv(Vram::Color color) {
+  // Like the RGB outputs: 2/3 of the full level for a normal color, the full one for a bright one.
+  const float value = (color & Vram::kBright) ? 1.0f : 2.0f / 3;
+  const float r = (color & Vram::kRed) ? value : 0;
+  const float g = (color & Vram::kGreen) ? value : 0;
+  const float b = (color & Vram::kBlue) ? value : 0;
+  const float y = 0.299f * r + 0.587f * g + 0.114f * b;
+  return {y, 0.493f * (b - y), 0.877f * (r - y)};
+}
+
+uint8_t ToSample(float level) {
+  const float sample = CvbsEncoder::kBlankLevel
+      + level * (CvbsEncoder::kWhiteLevel - CvbsEncoder::kBlankLevel) + 0.5f;
+  return (uint8_t) std::clamp(sample, 0.0f, 255.0f);
+}
+
+// The burst is at 135 degrees (-U +V) on the lines with the V-switch off, and at 225 degrees
+// (-U -V) on the others, with the amplitude of 0.3 V peak-to-peak, i.e. 3/7 of the white level.
+constexpr float kBurstComponent = 0.3f / 2 / 0.7f / 1.41421356f;
+
+}  // namespace
+
+void CvbsEncoder::Init(const VideoMode& video_mode, int image_begin) {
+  ASSERT_CMP(video_mode.whole_line, ==, kLineSampleCount);
+  image_begin_ = image_begin;
+  // The burst starts 5.6 us after the leading edge of H-sync, and lasts 10 cycles (2.25 us).
+  const int h_sync_pulse_front = video_mode.h_visible_area + video_mode.h_front_porch;
+  burst_begin_ = h_sync_pulse_front + kLineSampleCount * 56 / 640;
+  burst_end_ = burst_begin_ + kLineSampleCount * 1000 / 28375;  // 10 of 283.75 cycles.
+  ASSERT_CMP(burst_end_, <=, kLineSampleCount);
+
+  for (int v_switch = 0; v_switch < 2; ++v_switch) {
+    const float v_sign = v_switch ? -1.0f : 1.0f;
+    for (int phase = 0; phase < kPhaseCount; ++phase) {
+      const float angle = 2 * (float) M_PI * phase / kPhaseCount;
+      const float sin_value = sinf(angle);
+      const float cos_value = cosf(angle);
+      for (int color = 0; color < Vram::kColorCount; ++color) {
+        const Yuv yuv = ToYuv((Vram::Color) color);
+        color_samples_[v_switch][color][phase] =
+            ToSample(yuv.y + yuv.u * sin_value + v_sign * yuv.v * cos_value);
+      }
+      burst_samples_[v_switch][phase] =
+          ToSample(-kBurstComponent * sin_value + v_sign * kBurstComponent * cos_value);
+    }
+  }
+}
+
+void __not_in_flash_func(CvbsEncoder::EncodeBurst)(uint8_t* line, int y) const {
+  // The burst follows the H-sync pulse at the tail of the buffer y, so it belongs to the TV line
+  // whose picture is at the start of the buffer y + 1, and takes the V-switch of that line.
+  const uint8_t* const samples = burst_samples_[(y + 1) % 2];
+  uint32_t phase = Phase(y, burst_begin_);
+  for (int i = burst_begin_; i < burst_end_; ++i) {
+    line[i] = samples[phase >> (32 - kPhaseBits)];
+    phase += kPhaseStep;
+  }
+}
+
+void __not_in_flash_func(CvbsEncoder::EncodeLine)(
+    uint8_t* line, int y, Span<const uint8_t> vram_line_bytes) const {
+  static_assert(kSamplesPerPixel == 4);
+  const auto& samples = color_samples_[y % 2];
+  uint8_t* sample_ptr = line + image_begin_;
+  uint32_t phase = Phase(y, image_begin_);
+  const auto put_pixel = [&](const uint8_t* color_samples) {
+    for (int i = 0; i < kSamplesPerPixel; ++i) {
+      *sample_ptr++ = color_samples[phase >> (32 - kPhaseBits)];
+      phase += kPhaseStep;
+    }
+  };
+  const uint8_t* const vram_bytes = vram_line_bytes.data();
+  for (int x = 0; x < vram_line_bytes.size(); ++x) {
+    const uint8_t byte = vram_bytes[x];
+    put_pixel(samples[byte & 0x0F]);  // The even pixel is the low nibble.
+    put_pixel(samples[byte >> 4]);
+  }
+  EncodeBurst(line, y);
+}
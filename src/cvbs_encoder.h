@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <pico.h>
+
+#include "span.h"
+#include "video_mode.h"
+#include "vram.h"
+
+// PAL composite video (CVBS) synthesized as 8-bit samples, one per output pixel, for a resistor
+// ladder DAC on the 8 output pins; see Config::Mode::cvbs.
+//
+// The sample rate is 1344 samples per 64-us line (21 MHz), and the subcarrier makes 283.75 cycles
+// per line (4433593.75 Hz, 25 Hz below the PAL standard, which is well within the lock range of
+// the TV). Then the subcarrier phase at the start of a line repeats every 4 lines, and the V-axis
+// switch every 2 lines; a progressive frame of a multiple of 4 lines starts with the same phase,
+// so the blank lines can be precomputed.
+//
+// For each Vram color, the samples are precomputed for 64 subcarrier phases and both V-switch
+// states, so that a line is encoded with a table lookup per sample.
+class CvbsEncoder {
+ public:
+  static constexpr int kLineSampleCount = 1344;
+  static constexpr int kLinePhasePeriod = 4;  // Lines after which the line phase repeats.
+  static constexpr int kSamplesPerPixel = 4;
+
+  // DAC levels; 1.0 V above the sync tip is 204 with the ladder in the readme.
+  static constexpr uint8_t kSyncLevel = 0;
+  static constexpr uint8_t kBlankLevel = 61;
+  static constexpr uint8_t kWhiteLevel = 204;
+
+  // `video_mode` gives the line layout, and `image_begin` is the sample of the first Vram pixel.
+  void Init(const VideoMode& video_mode, int image_begin);
+
+  // Puts the color burst into the buffer of the line y, after the H-sync pulse; it carries the
+  // V-switch of the line y + 1, which starts at that pulse.
+  void EncodeBurst(uint8_t* line, int y) const;
+
+  // Puts the Vram line and the color burst into the buffer of the line y; the margins and the sync
+  // pulse are left as is.
+  void EncodeLine(uint8_t* line, int y, Span<const uint8_t> vram_line_bytes) const;
+
+ private:
+  static constexpr int kPhaseBits = 6;
+  static constexpr int kPhaseCount = 1 << kPhaseBits;
+  static constexpr uint32_t kPhaseStep =
+      (uint32_t) (283.75 / kLineSampleCount * 4294967296.0 + 0.5);  // Per sample, 2^32 = 1 cycle.
+
+  int image_begin_ = 0;
+  int burst_begin_ = 0;
+  int burst_end_ = 0;
+
+  // [V-switch][color][phase].
+  uint8_t color_samples_[2][Vram::kColorCount][kPhaseCount];
+  uint8_t burst_samples_[2][kPhaseCount];
+
+  // Subcarrier phase at the sample of the line y; the line y starts 0.75 cycles after line y - 1.
+  static __force_inline uint32_t Phase(int y, int sample) {
+    return (uint32_t) (y % kLinePhasePeriod) * 0xC000'0000u + (uint32_t) sample * kPhaseStep;
+  }
+};
@@ -189,6 +189,27 @@ void SetBuiltInLed(bool is_on) {
   }
 }
 
+void CycleStats::StartSysTick() {
+  systick_hw->rvr = 0x00FFFFFF;
+  systick_hw->cvr = 0;
+  systick_hw->csr = /*CLKSOURCE: clk_sys*/ 0b100 | /*ENABLE*/ 0b001;
+}
+
+void CycleStats::PrintAndReset(const char* name) {
+  const uint32_t count = count_;
+  const uint64_t sum = sum_;
+  const uint32_t max = max_;
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+  if (count == 0) {
+    printf("%s: no samples\n", name);
+    return;
+  }
+  printf("%s: %lu samples, avg %lu cycles, max %lu cycles\n",
+      name, (unsigned long) count, (unsigned long) (sum / count), (unsigned long) max);
+}
+
 } using namespace debug;
 
 extern "C" {
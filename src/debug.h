@@ -3,7 +3,9 @@
 #include <stdio.h>
 
 #include <pico/stdlib.h>
+#include <hardware/structs/systick.h>
 
+#include "config.h"
 #include "nx/kit/utils.h"
 
 namespace debug {
@@ -107,4 +109,58 @@ void SetBuiltInLed(bool is_on);
   }() \
 )
 
+//-------------------------------------------------------------------------------------------------
+
+// Accumulates durations of a piece of code, in CPU cycles, measured via the SysTick timer of the
+// calling core. SysTick counts down from 0xFFFFFF at the clk_sys rate, so a single measured
+// duration must be less than 2^24 cycles (66 ms at 252 MHz).
+//
+// Intended to be updated from an IRQ handler and printed from the main loop; the stats may be
+// slightly inconsistent if printed in the middle of an update, which is fine for profiling.
+class CycleStats {
+ public:
+  // Must be called once on each core which measures anything.
+  static void StartSysTick();
+
+  __force_inline static uint32_t Now() { return systick_hw->cvr; }
+
+  // The start value must be obtained via Now() on the same core.
+  __force_inline void AddSince(uint32_t start) {
+    const uint32_t cycles = (start - systick_hw->cvr) & 0x00FFFFFF;
+    count_ = count_ + 1;
+    sum_ = sum_ + cycles;
+    if (cycles > max_) {
+      max_ = cycles;
+    }
+  }
+
+  // Print the average and maximum duration since the previous call, and reset the stats.
+  void PrintAndReset(const char* name);
+
+ private:
+  volatile uint32_t count_ = 0;
+  volatile uint64_t sum_ = 0;
+  volatile uint32_t max_ = 0;
+};
+
+// Adds the duration of its scope to the given CycleStats if -DPROFILE=on; does nothing otherwise.
+class ScopedCycleMeter {
+ public:
+  __force_inline explicit ScopedCycleMeter(CycleStats& stats): stats_(&stats) {
+    if constexpr (Config::kProfile == Config::Profile::on) {
+      start_ = CycleStats::Now();
+    }
+  }
+
+  __force_inline ~ScopedCycleMeter() {
+    if constexpr (Config::kProfile == Config::Profile::on) {
+      stats_->AddSince(start_);
+    }
+  }
+
+ private:
+  CycleStats* stats_;
+  uint32_t start_ = 0;
+};
+
 }  // namespace debug
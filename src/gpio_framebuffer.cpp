@@ -0,0 +1,42 @@
+#include "gpio_framebuffer.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+GpioFramebuffer::GpioFramebuffer(int width_px, int height):
+    width_px_(width_px), height_(height), buffer_((uint8_t*) malloc(width_px * height)) {
+  ASSERT_CMP(width_px % 4, ==, 0);
+  ASSERT_CMP(width_px, >, 0);
+  ASSERT_CMP(height, >, 0);
+  if (ASSERT(buffer_ != nullptr, "No RAM for the %dx%d GPIO framebuffer", width_px, height)) {
+    Clear();
+  }
+}
+
+void GpioFramebuffer::Clear(uint8_t gpio_byte) {
+  memset(buffer_, gpio_byte, width_px_ * height_);
+}
+
+void GpioFramebuffer::SetPixel(int x, int y, uint8_t gpio_byte) {
+  if (!ASSERT_CMP(x, >=, 0)
+      || !ASSERT_CMP(x, <, width_px_)
+      || !ASSERT_CMP(y, >=, 0)
+      || !ASSERT_CMP(y, <, height_)) {
+    return;
+  }
+  buffer_[y * width_px_ + x] = gpio_byte;
+}
+
+void GpioFramebuffer::FillRect(int x, int y, int width, int height, uint8_t gpio_byte) {
+  const int begin_x = std::max(x, 0);
+  const int end_x = std::min(x + width, width_px_);
+  const int begin_y = std::max(y, 0);
+  const int end_y = std::min(y + height, height_);
+  if (begin_x >= end_x) {
+    return;
+  }
+  for (int line_y = begin_y; line_y < end_y; ++line_y) {
+    memset(&buffer_[line_y * width_px_ + begin_x], gpio_byte, end_x - begin_x);
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+
+#include <pico.h>
+
+#include "debug.h"
+#include "span.h"
+
+// Frame buffer of one byte per pixel, holding the levels of the 8 output pins as is, so that the
+// scanout feeds its lines to the PIO with no conversion; see Config::kFramebuffer. Which bits are
+// R, G and B is up to the caller; the bits of the pins driven by the PIO sync programs are ignored.
+//
+// Unlike Vram, the buffer is allocated for the given size, because it is needed only with
+// -DFRAMEBUFFER=gpio. The width is a multiple of 4, so that the lines are whole 32-bit words for
+// the DMA.
+class GpioFramebuffer {
+ public:
+  GpioFramebuffer(int width_px, int height);
+
+  int width_px() const { return width_px_; };
+  int height() const { return height_; }
+
+  __force_inline Span<const uint8_t> LineBytes(int y) const {
+    return {
+        &buffer_[((ASSERT_CMP(y, >=, 0) && ASSERT_CMP(y, <, height_)) ? y : 0) * width_px_],
+        width_px_};
+  }
+
+  __force_inline Span<uint8_t> LineBytes(int y) {
+    return std::as_const(*this).LineBytes(y).AsMutable();
+  }
+
+  void Clear(uint8_t gpio_byte = 0);
+
+  void SetPixel(int x, int y, uint8_t gpio_byte);
+
+  // Fills the rectangle, clipped to the buffer.
+  void FillRect(int x, int y, int width, int height, uint8_t gpio_byte);
+
+ private:
+  const int width_px_;
+  const int height_;
+  uint8_t* const buffer_;
+};
@@ -0,0 +1,77 @@
+#include "line_patterns.h"
+
+#include <iterator>
+#include <string.h>
+
+#include "debug.h"
+
+LinePatterns::LinePatterns(int width_px, int height) : width_px_(width_px), height_(height) {
+  ASSERT_CMP(width_px % 2, ==, 0);
+  ASSERT_CMP(width_px, >, 0);
+  ASSERT_CMP(width_px / 2, <=, (int) sizeof(line_));
+  ASSERT_CMP(height, >, 0);
+}
+
+Span<const uint8_t> __not_in_flash_func(LinePatterns::LineBytes)(int y) {
+  static constexpr Vram::Color kColorBars[]{
+      Vram::kBrightWhite,
+      Vram::kBrightYellow,
+      Vram::kBrightCyan,
+      Vram::kBrightGreen,
+      Vram::kBrightMagenta,
+      Vram::kBrightRed,
+      Vram::kBrightBlue,
+      Vram::kBlack,
+  };
+  // Only 3 steps: the outputs show kBrightBlack as black.
+  static constexpr Vram::Color kGraySteps[]{
+      Vram::kBlack,
+      Vram::kWhite,
+      Vram::kBrightWhite,
+  };
+
+  const Pattern pattern = this->pattern();
+  const Vram::Color purity_color = purity_color_.load(std::memory_order_relaxed);
+  const int line_y = (pattern == Pattern::crosshatch) ? y : 0;  // Others repeat on all lines.
+  if (pattern == line_pattern_ && line_y == line_y_ && purity_color == line_purity_color_) {
+    return {line_, width_px_ / 2};
+  }
+  switch (pattern) {
+    case Pattern::color_bars: FillBars(kColorBars, std::size(kColorBars)); break;
+    case Pattern::gray_steps: FillBars(kGraySteps, std::size(kGraySteps)); break;
+    case Pattern::crosshatch: FillCrosshatch(y); break;
+    case Pattern::purity: FillSolid(purity_color); break;
+    default: ASSERT(false, "Unexpected pattern %d", (int) pattern); FillSolid(Vram::kBlack);
+  }
+  line_pattern_ = pattern;
+  line_y_ = line_y;
+  line_purity_color_ = purity_color;
+  return {line_, width_px_ / 2};
+}
+
+void __not_in_flash_func(LinePatterns::FillBars)(const Vram::Color* colors, int count) {
+  // Bar edges are rounded to a byte, i.e. to two pixels.
+  const int byte_count = width_px_ / 2;
+  for (int i = 0; i < count; ++i) {
+    const int begin = byte_count * i / count;
+    const int end = byte_count * (i + 1) / count;
+    memset(&line_[begin], (colors[i] << 4) | colors[i], end - begin);
+  }
+}
+
+void __not_in_flash_func(LinePatterns::FillCrosshatch)(int y) {
+  constexpr uint8_t kLineColor = Vram::kBrightWhite;
+  if (y % kCrosshatchCellSize == 0 || y == height_ - 1) {
+    FillSolid(Vram::kBrightWhite);
+    return;
+  }
+  FillSolid(Vram::kBlack);
+  for (int x = 0; x < width_px_; x += kCrosshatchCellSize) {
+    line_[x / 2] = kLineColor;  // The even pixel is the low nibble.
+  }
+  line_[width_px_ / 2 - 1] = kLineColor << 4;  // The last pixel.
+}
+
+void __not_in_flash_func(LinePatterns::FillSolid)(Vram::Color color) {
+  memset(line_, (color << 4) | color, width_px_ / 2);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include <pico.h>
+
+#include "span.h"
+#include "vram.h"
+
+// Service test patterns, computed per line when the scanout asks for a line, instead of being
+// rasterized into Vram. Lines are in the Vram format, so that the scanout converts them the same
+// way as Vram lines; see Config::kLineSource.
+//
+// The pattern can be switched at any time, e.g. from the main loop; the next line asked for by the
+// scanout already shows the new pattern. Only one line buffer is used, so LineBytes() must be
+// called by a single consumer, which is done with the span before the next call.
+class LinePatterns {
+ public:
+  enum class Pattern: uint8_t {
+    color_bars,  // 8 vertical bars: white, yellow, cyan, green, magenta, red, blue, black.
+    gray_steps,  // 3 vertical bars: black, white, bright white.
+    crosshatch,  // A white grid of 16x16-pixel cells on black, framed at the edges.
+    purity,  // The whole field in the purity color, see SetPurityColor().
+    count
+  };
+
+  LinePatterns(int width_px, int height);
+
+  int width_px() const { return width_px_; };
+  int height() const { return height_; }
+
+  void Select(Pattern pattern) { pattern_.store(pattern, std::memory_order_relaxed); }
+  Pattern pattern() const { return pattern_.load(std::memory_order_relaxed); }
+
+  void SetPurityColor(Vram::Color color) {
+    purity_color_.store(color, std::memory_order_relaxed);
+  }
+
+  // Generates the line of the selected pattern; the span is valid until the next call.
+  Span<const uint8_t> LineBytes(int y);
+
+ private:
+  static constexpr int kCrosshatchCellSize = 16;
+
+  const int width_px_;
+  const int height_;
+  std::atomic<Pattern> pattern_ = Pattern::color_bars;
+  std::atomic<Vram::Color> purity_color_ = Vram::kRed;
+
+  // The generated line is kept while the same line of the same pattern is asked for again.
+  alignas(4) uint8_t line_[Vram::kStride];
+  Pattern line_pattern_ = Pattern::count;
+  int line_y_ = -1;
+  Vram::Color line_purity_color_ = Vram::kBlack;
+
+  void FillBars(const Vram::Color* colors, int count);
+  void FillCrosshatch(int y);
+  void FillSolid(Vram::Color color);
+};
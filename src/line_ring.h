@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pico.h>
+
+// Lock-free single-producer/single-consumer ring of DMA line buffers, filled ahead of the beam in
+// the order the lines are scanned out. The producer and the consumer may run on different cores.
+//
+// Lines are identified by a free-running sequence number: line `seq` goes to the slot
+// `seq % kDepth`. The producer converts the lines in order; the consumer arms the slot of the line
+// to be scanned out, and releases the slots of the lines preceding the one which the DMA is
+// currently reading. Only atomic loads and stores are used, because Cortex-M0+ has no atomic
+// read-modify-write instructions.
+//
+// With kDepth == 2, one slot is being read while the other is being converted; each extra slot
+// allows the producer to run one more line ahead of the beam.
+template <int kDepth>
+class LineRing {
+ public:
+  // A power of 2 keeps `seq % kDepth` continuous when the sequence number wraps around.
+  static_assert(kDepth == 2 || kDepth == 4 || kDepth == 8);
+
+  // Allocate the buffers, each initialized with a copy of the given line (porches and syncs).
+  // Must be called before the producer and the consumer start.
+  void Init(const uint32_t* blank_line, int line_size_bytes) {
+    for (uint32_t*& buf: bufs_) {
+      buf = (uint32_t*) malloc(line_size_bytes);
+      memcpy(buf, blank_line, line_size_bytes);
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  // Producer side.
+
+  __force_inline uint32_t produced() const { return produced_.load(std::memory_order_relaxed); }
+
+  __force_inline bool CanProduce() const {
+    return (int32_t) (produced() - released_.load(std::memory_order_acquire)) < kDepth;
+  }
+
+  // If the consumer has released lines which were not produced in time (they were shown as late
+  // lines), skip them, so that the slot being read is never overwritten. Return the number of the
+  // skipped lines.
+  __force_inline uint32_t SkipReleased() {
+    const uint32_t released = released_.load(std::memory_order_acquire);
+    const int32_t skipped = (int32_t) (released - produced());
+    if (skipped <= 0) {
+      return 0;
+    }
+    produced_.store(released, std::memory_order_release);
+    return skipped;
+  }
+
+  // Whether the consumer has released all the produced lines, e.g. at the end of a frame.
+  __force_inline bool IsAllReleased() const {
+    return (int32_t) (released_.load(std::memory_order_acquire) - produced()) >= 0;
+  }
+
+  // The slot to convert the next line into; valid only if CanProduce().
+  __force_inline uint32_t* ProducerSlot() const { return bufs_[produced() % kDepth]; }
+
+  // Publish the line converted into ProducerSlot().
+  __force_inline void Produce() { produced_.store(produced() + 1, std::memory_order_release); }
+
+  //-----------------------------------------------------------------------------------------------
+  // Consumer side.
+
+  __force_inline bool IsProduced(uint32_t seq) const {
+    return (int32_t) (produced_.load(std::memory_order_acquire) - seq) > 0;
+  }
+
+  // The address of the slot pointer, as needed for the control DMA channel.
+  __force_inline uint32_t* const* SlotPtr(uint32_t seq) const { return &bufs_[seq % kDepth]; }
+
+  // Allow the producer to reuse the slots of the lines before `seq`.
+  __force_inline void ReleaseBefore(uint32_t seq) {
+    released_.store(seq, std::memory_order_release);
+  }
+
+ private:
+  uint32_t* bufs_[kDepth];
+  std::atomic<uint32_t> produced_ = 0;  // Written by the producer only.
+  std::atomic<uint32_t> released_ = 0;  // Written by the consumer only.
+};
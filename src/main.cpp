@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <utility>
 #include <stdint.h>
 
 #include <pico.h>
@@ -12,6 +15,7 @@
 #include <hardware/clocks.h>
 #include <hardware/vreg.h>
 #include <hardware/dma.h>
+#include <hardware/interp.h>
 #include <hardware/irq.h>
 #include <hardware/structs/pll.h>
 #include <hardware/structs/systick.h>
@@ -20,10 +24,20 @@
 
 #include "agat7_picture.h"
 #include "agat7_renderer.h"
+#include "agat7_text_mode.h"
 #include "config.h"
+#include "cvbs_encoder.h"
 #include "debug.h"
+#include "gpio_framebuffer.h"
+#include "line_patterns.h"
+#include "line_ring.h"
+#include "pixel_repetition.h"
+#include "scanout_geometry.h"
+#include "tmds_encoder.h"
 #include "video_mode.h"
 #include "vram.h"
+#include "vram_dma_fill.h"
+#include "vram_interp_lanes.h"
 
 // TODO:
 // - Fix coding style:
@@ -32,7 +46,6 @@
 //   - Rename all enum class items with the `k` prefix.
 // - Draw ASCII diagrams for all modes.
 // - Add comments explaining the TV scan principles.
-// - Add a PAL/SECAM Field 1 standard mode: 52 us, 313 lines, 288 visible lines.
 // - Refactor to use a complete time frame buffer starting with v-front-porch, lines starting with
 //   h-front-porch.
 //   - In VGA mode, draw the entire buffer in the middle, visualizing the porches/pulses amd
@@ -44,6 +57,9 @@
 constexpr int kRedGpioShift = 0;
 constexpr int kGreenGpioShift = 2;
 constexpr int kBlueGpioShift = 4;
+constexpr int kRgbGpioCount = 6;
+constexpr int kHSyncGpioShift = 6;
+constexpr int kVSyncGpioShift = 7;
 constexpr uint8_t kNoSyncGpioByte = 0b00000000;
 constexpr uint8_t kVSyncGpioByte = 0b10000000;
 constexpr uint8_t kHSyncGpioByte = 0b01000000;
@@ -148,15 +164,123 @@ static_assert(
     + kVideoModePentagon128.v_back_porch
     + kVideoModePentagon128.v_visible_area
     == kVideoModePentagon128.whole_frame);
-static Vram vram(/*width_px=*/256, /*height=*/256);
-static Agat7Renderer agat7_renderer(vram);
+
+// Interlaced PAL/SECAM 625/50: 52 us of 64 us, 2 fields of 312.5 lines, 288 visible lines each.
+// The vertical fields are totals over both fields; the exact half-line sync sequence of each field
+// is built by pal625i_csync_line(). The pixel clock is the Agat-7 one, so that the Vram lines are
+// converted the same way.
+constexpr VideoMode kVideoModePal625i{
+    .sys_freq = 252'000,
+    .pixel_freq = 5'250'000.0,
+    .h_visible_area = 272,  // 51.8 us.
+    .v_visible_area = 576,
+    .whole_line = 336,
+    .whole_frame = 625,
+    .h_front_porch = 8,  // 1.5 us.
+    .h_sync_pulse = 25,  // 4.8 us.
+    .h_back_porch = 31,  // 5.9 us.
+    .v_front_porch = 5,  // 2.5 lines of equalizing pulses per field.
+    .v_sync_pulse = 5,  // 2.5 lines of broad pulses per field.
+    .v_back_porch = 39,
+    .sync_polarity =
+        (Config::kSync == Config::Sync::neg) ? kSyncPolatiryMaskNegative :
+        (Config::kSync == Config::Sync::pos) ? kSyncPolatiryMaskPositive :
+        printf/*compile-time error*/("Unexpected SYNC\n"),
+    .h_scale = 1,
+    .v_scale = 1,  // Unused: see Config::kInterlace.
+};
+static_assert(
+    kVideoModePal625i.h_front_porch
+    + kVideoModePal625i.h_sync_pulse
+    + kVideoModePal625i.h_back_porch
+    + kVideoModePal625i.h_visible_area
+    == kVideoModePal625i.whole_line);
+static_assert(
+    kVideoModePal625i.v_front_porch
+    + kVideoModePal625i.v_sync_pulse
+    + kVideoModePal625i.v_back_porch
+    + kVideoModePal625i.v_visible_area
+    == kVideoModePal625i.whole_frame);
+static_assert(Config::kMode != Config::Mode::pal
+    || (Config::kTiming == Config::Timing::dma
+        && Config::kPixelUnpacking == Config::PixelUnpacking::cpu
+        && Config::kAgat7Scanout == Config::Agat7Scanout::chain),
+    "The PAL mode is scanned out by the Agat-7 frame chain only");
+
+// PAL composite video, see CvbsEncoder: the Agat-7 frame, 1344 samples per line at 21 MHz, each
+// Vram pixel being 4 samples; the sync pulses and the color burst are DAC levels, not GPIO bits.
+constexpr VideoMode kVideoModeCvbs{
+    .sys_freq = 252'000,
+    .pixel_freq = 21'000'000.0,
+    .h_visible_area = 1092,  // 52 us.
+    .v_visible_area = 256,
+    .whole_line = CvbsEncoder::kLineSampleCount,
+    .whole_frame = 312,
+    .h_front_porch = 36,  // 1.7 us.
+    .h_sync_pulse = 100,  // 4.8 us.
+    .h_back_porch = 116,  // 5.5 us.
+    .v_front_porch = 28,
+    .v_sync_pulse = 4,
+    .v_back_porch = 24,
+    .sync_polarity = kSyncPolatiryMaskPositive,  // Unused.
+    .h_scale = CvbsEncoder::kSamplesPerPixel,
+    .v_scale = 1,
+};
+static_assert(
+    kVideoModeCvbs.h_front_porch
+    + kVideoModeCvbs.h_sync_pulse
+    + kVideoModeCvbs.h_back_porch
+    + kVideoModeCvbs.h_visible_area
+    == kVideoModeCvbs.whole_line);
+static_assert(
+    kVideoModeCvbs.v_front_porch
+    + kVideoModeCvbs.v_sync_pulse
+    + kVideoModeCvbs.v_back_porch
+    + kVideoModeCvbs.v_visible_area
+    == kVideoModeCvbs.whole_frame);
+static_assert(kVideoModeCvbs.whole_frame % CvbsEncoder::kLinePhasePeriod == 0,
+    "Every frame must start with the same subcarrier phase");
+static_assert(kVideoModeCvbs.v_scale == 1,
+    "The line producer takes the frame line of a sequence number for the subcarrier phase");
+static_assert(Config::kMode != Config::Mode::cvbs
+    || (Config::kTiming == Config::Timing::dma
+        && Config::kPixelUnpacking == Config::PixelUnpacking::cpu),
+    "CVBS is encoded by the line ring scanout only");
+
+// -DMODE=dvi shows the VGA frame, kVideoModeVga640x480x60, as TMDS symbols, see TmdsEncoder; the
+// bit clock is the system clock.
+static_assert(kVideoModeVga640x480x60.sys_freq * 1000
+    == kVideoModeVga640x480x60.pixel_freq * TmdsEncoder::kSymbolBits);
+static_assert(kVideoModeVga640x480x60.h_scale == TmdsEncoder::kPixelRepetition);
+static_assert(Config::kMode != Config::Mode::dvi
+    || (Config::kTiming == Config::Timing::dma
+        && Config::kPixelUnpacking == Config::PixelUnpacking::cpu
+        && Config::kSyncOutput == Config::SyncOutput::hv),
+    "TMDS is encoded by the line ring scanout only");
+
+// The line sources: only the one of Config::kLineSource is allocated, by main(), so that the
+// others take no RAM. The code which runs with any of them uses each only in `if constexpr`
+// branches of Config::kLineSource.
+static Vram* vram = nullptr;
+static LinePatterns* line_patterns = nullptr;
+static Agat7TextMode* agat7_text_mode = nullptr;
+// With -DFRAMEBUFFER=gpio, allocated by main() for the visible area of the mode.
+static GpioFramebuffer* gpio_framebuffer = nullptr;
 
 //-------------------------------------------------------------------------------------------------
 // Video output
 
-// For each two Vram pixels (1 byte), produces two bytes, each mapped to the video output GPIOs.
+// For each Vram byte, produces the bytes of its Vram::kPixelsPerByte pixels, each mapped to the
+// video output GPIOs, the first pixel in the low byte: e.g. 2 bytes for two 4-bit pixels, and 8
+// bytes for eight 1-bit ones. So this is the expansion kernel of each Vram depth.
 class Palette {
  public:
+  using Pixels =
+      std::conditional_t<Vram::kPixelsPerByte == 1, uint8_t,
+      std::conditional_t<Vram::kPixelsPerByte == 2, uint16_t,
+      std::conditional_t<Vram::kPixelsPerByte == 4, uint32_t, uint64_t>>>;
+  static_assert(sizeof(Pixels) == Vram::kPixelsPerByte);
+
   void Init(const VideoMode& video_mode) {
     using enum Vram::Color;
     const uint8_t sync_gpio_byte = kNoSyncGpioByte ^ video_mode.sync_polarity;
@@ -169,23 +293,62 @@ class Palette {
       return sync_gpio_byte |
           (r << kRedGpioShift) | (g << kGreenGpioShift) | (b << kBlueGpioShift);
     };
-    for (int hi = 0; hi < kColorCount; ++hi) {
-      const uint8_t hi_gpio_byte = to_gpio_byte(static_cast<Vram::Color>(hi));
-      for (int lo = 0; lo < kColorCount; ++lo) {
-        map_[hi * kColorCount + lo] =
-            (hi_gpio_byte << 8) | to_gpio_byte(static_cast<Vram::Color>(lo));
+    // The gray level of a 2-bit pixel is put directly on the 2-bit DAC of each channel, so that
+    // the 4 levels differ.
+    auto to_gray_gpio_byte = [sync_gpio_byte](uint8_t level) -> uint8_t {
+      return sync_gpio_byte |
+          (level << kRedGpioShift) | (level << kGreenGpioShift) | (level << kBlueGpioShift);
+    };
+    for (int byte = 0; byte < 256; ++byte) {
+      Pixels pixels = 0;
+      for (int i = 0; i < Vram::kPixelsPerByte; ++i) {
+        const uint8_t pixel = (byte >> (i * Vram::kBitsPerPixel)) & Vram::kPixelMask;
+        uint8_t gpio_byte;
+        if constexpr (Vram::kBitsPerPixel == 2) {
+          gpio_byte = to_gray_gpio_byte(pixel);
+        } else {
+          gpio_byte = to_gpio_byte(Vram::PixelColor(pixel));
+        }
+        pixels |= (Pixels) gpio_byte << (i * 8);
       }
+      map_[byte] = pixels;
     }
   }
 
-  uint16_t operator[](uint8_t byte) const { return map_[byte]; }
+  Pixels operator[](uint8_t byte) const { return map_[byte]; }
 
  private:
-  std::array<uint16_t, 256> map_;
+  std::array<Pixels, 256> map_;
 };
 
 static Palette palette;
 
+// For each two Vram pixels (1 byte), produces four bytes - each pixel doubled, mapped to the video
+// output GPIOs. Allows the VGA line conversion to store a 32-bit word per Vram byte.
+class DoubledPalette {
+ public:
+  void Init(const Palette& palette) {
+    for (int byte = 0; byte < 256; ++byte) {
+      const uint32_t lo_gpio_byte = palette[byte] & 0xFF;
+      const uint32_t hi_gpio_byte = palette[byte] >> 8;
+      map_[byte] =
+          lo_gpio_byte | (lo_gpio_byte << 8) | (hi_gpio_byte << 16) | (hi_gpio_byte << 24);
+    }
+  }
+
+  uint32_t operator[](uint8_t byte) const { return map_[byte]; }
+  const uint32_t* data() const { return map_.data(); }
+
+ private:
+  std::array<uint32_t, 256> map_;
+};
+
+static DoubledPalette doubled_palette;
+
+static CvbsEncoder cvbs_encoder;
+
+static TmdsEncoder tmds_encoder;
+
 static VideoMode video_mode;
 
 // Position of Vram insode the VGA visible rectangle.
@@ -198,48 +361,367 @@ struct VgaParams {
 
 static VgaParams vga_params;
 
-// 4 buffers, each represents a full video-out line (with porches), including invisible lines.
+// Whether VideoMode::h_scale is applied by the VGA line conversion, which emits each Vram pixel
+// twice via DoubledPalette with -DPIXEL_DOUBLING=conversion (or via CvbsEncoder and TmdsEncoder),
+// rather than by slowing down the PIO clock. Then the PIO runs at the native pixel clock, and the
+// porches and syncs are timed with the native pixel precision. Not needed with -DTIMING=pio, where
+// the PIO repeats the pixels.
+constexpr bool is_h_scale_in_vga_conversion(const VideoMode& video_mode) {
+  return (Config::kMode == Config::Mode::cvbs || Config::kMode == Config::Mode::dvi)
+      || (Config::kMode == Config::Mode::vga
+          && Config::kTiming == Config::Timing::dma
+          && Config::kPixelUnpacking == Config::PixelUnpacking::cpu
+          && Config::kPixelDoubling == Config::PixelDoubling::conversion
+          && video_mode.h_scale == 2);
+}
+
+// The part of VideoMode::h_scale applied by the PIO: by slowing down its clock with
+// -DTIMING=dma, or by repeating each pixel in pio_vga_pixels (pio_vga_nibbles) with -DTIMING=pio,
+// where the porches and syncs are still timed at the native pixel clock.
+constexpr int pio_h_scale(const VideoMode& video_mode) {
+  return is_h_scale_in_vga_conversion(video_mode) ? 1 : video_mode.h_scale;
+}
+
+// Size of a DMA line buffer, in bytes - that is, in PIO pixels: the whole line with the
+// porches and syncs, or only the visible area if they are generated by the PIO (-DTIMING=pio).
+// With -DMODE=dvi, a pixel takes TmdsEncoder::kBytesPerPixel.
+constexpr int dma_line_size(const VideoMode& video_mode) {
+  const int pixel_count =
+      (Config::kTiming == Config::Timing::pio) ? video_mode.h_visible_area : video_mode.whole_line;
+  const int pixel_size = (Config::kMode == Config::Mode::dvi) ? TmdsEncoder::kBytesPerPixel : 1;
+  return pixel_count / pio_h_scale(video_mode) * pixel_size;
+}
+
+// The most visible lines of the modes which map their lines via vga_line_seqs[], i.e. all but
+// -DMODE=pal, which has only the frame chain.
+constexpr int kMaxLineMapVisibleArea = std::max({kVideoModeVga640x480x60.v_visible_area,
+    kVideoModeAgat7.v_visible_area, kVideoModeCvbs.v_visible_area});
+
+// Source-line map of the VGA visible area, precomputed for any vertical scale: for each visible
+// VGA line, the sequence number of its Vram line within the frame, or -1 for the black bars.
+static int16_t vga_line_seqs[kMaxLineMapVisibleArea];
+// Vram line for each sequence number; consecutive VGA lines showing the same Vram line share it.
+static int16_t vga_seq_vram_lines[kMaxLineMapVisibleArea];
+static int vga_seq_count;
+
+// A sync pulse on the H-sync pin: H-sync, equalizing (half as wide as H-sync), or broad (half a
+// line minus an H-sync-wide serration).
+enum class SyncPulse: uint8_t { none, hsync, equalizing, broad };
+
+// A line of the composite sync (-DSYNC_OUTPUT=csync), from the leading edge of its sync pulse to
+// the next one: the pulses at its start and in its middle, half a line later.
+struct CsyncLine {
+  SyncPulse start;
+  SyncPulse middle;
+
+  bool operator==(const CsyncLine&) const = default;
+};
+constexpr CsyncLine kNormalCsyncLine{SyncPulse::hsync, SyncPulse::none};
+constexpr CsyncLine kEqualizingCsyncLine{SyncPulse::equalizing, SyncPulse::equalizing};
+constexpr CsyncLine kBroadCsyncLine{SyncPulse::broad, SyncPulse::broad};
+
+// Equalizing lines before and after the broad lines, which are the V-sync-pulse lines. PAL has
+// 2.5 lines of each; the whole lines of a progressive frame round it up.
+constexpr int kCsyncEqualizingLineCount = 3;
+
+// The type of a DMA buffer without image. A buffer starts with the visible area, so it holds the
+// end of the sync line which started at the H-sync position of the previous buffer (the tail of
+// its start pulse if it is broad, and its middle pulse), and the start of the next sync line.
+struct BlankLine {
+  CsyncLine prev_line;
+  SyncPulse start;
+  // The V-sync pin state before the middle pulse, from there to the start pulse, and after it.
+  bool is_vsync[3];
+  // With -DMODE=cvbs: the line whose color burst phase follows the start pulse, modulo
+  // CvbsEncoder::kLinePhasePeriod, or -1 for no burst.
+  int8_t burst_line = -1;
+  // With -DMODE=dvi: whether the visible area has black pixels (the black bars) rather than the
+  // control symbols of the vertical blanking.
+  bool is_video_period = false;
+
+  bool operator==(const BlankLine&) const = default;
+};
+constexpr BlankLine kBlankLine{kNormalCsyncLine, SyncPulse::hsync, {false, false, false},
+    /*burst_line*/ -1, /*is_video_period*/ Config::kMode == Config::Mode::dvi};
+
+// Buffers of dma_line_size() bytes without image, one per BlankLine and mode in use; all but
+// kDmaBufBlank are for -DTIMING=dma only. Allocated once by blank_dma_buf() when first needed.
+// With -DMODE=cvbs, the blank line has a variant for each color burst phase, kDmaBufBlank being
+// the first one.
 constexpr int kDmaBufBlank = 0;
-constexpr int kDmaBufVsync = 1;
-constexpr int kDmaBufImageA = 2;
-constexpr int kDmaBufImageB = 3;
-static uint32_t* dma_bufs[4];
+static uint32_t* dma_bufs[16];
+static BlankLine dma_buf_blank_lines[std::size(dma_bufs)];
+static const VideoMode* dma_buf_video_modes[std::size(dma_bufs)];
+static int dma_buf_count = 0;
+
+// The buffers of the vertical blanking lines, in the scanout order starting at v_visible_area,
+// picked from dma_bufs[] (-DTIMING=dma only).
+static uint32_t* v_blank_dma_bufs[
+    std::max(kVideoModeVga640x480x60.whole_frame - kVideoModeVga640x480x60.v_visible_area,
+        kVideoModeAgat7.whole_frame - kVideoModeAgat7.v_visible_area)];
+
+// The index in dma_bufs[] of the blank line for the line y.
+__force_inline int blank_dma_buf_index(int y) {
+  return (Config::kMode == Config::Mode::cvbs)
+      ? kDmaBufBlank + y % CvbsEncoder::kLinePhasePeriod : kDmaBufBlank;
+}
+
+// With -DTIMING=pio, the control DMA channel writes this null entry to the data channel trigger
+// register after the last image line, which stops the DMA until the PIO IRQ restarts it.
+static uint32_t* const null_dma_buf = nullptr;
+
+// Whether the DMA reads the Vram lines as is, walking vram_frame_dma_bufs[] by itself, and the PIO
+// unpacks the pixels (-DPIXEL_UNPACKING=pio), so that the CPU does nothing per line.
+constexpr bool kIsVramScanout = Config::kPixelUnpacking == Config::PixelUnpacking::pio;
+static_assert(!kIsVramScanout || Config::kTiming == Config::Timing::pio,
+    "The PIO unpacking takes the sync from the PIO timing");
+static_assert(!kIsVramScanout || Config::kAgat7Scanout == Config::Agat7Scanout::chain,
+    "The PIO unpacking has its own scanout");
+
+// Whether the DMA reads the lines of gpio_framebuffer as is, walking vram_frame_dma_bufs[] by
+// itself, and pio_vga_pixels outputs them with no conversion (-DFRAMEBUFFER=gpio).
+constexpr bool kIsGpioFramebuffer = Config::kFramebuffer == Config::Framebuffer::gpio;
+static_assert(!kIsGpioFramebuffer
+    || (Config::kTiming == Config::Timing::pio
+        && Config::kPixelUnpacking == Config::PixelUnpacking::cpu
+        && Config::kAgat7Scanout == Config::Agat7Scanout::chain
+        && Config::kLineSource == Config::LineSource::vram
+        && (Config::kMode == Config::Mode::agat7 || Config::kMode == Config::Mode::vga)),
+    "The GPIO framebuffer has its own scanout, with the sync from the PIO timing");
+
+// Whether the DMA walks the frame table of the framebuffer lines by itself, with no CPU work per
+// line.
+constexpr bool kIsDirectScanout = kIsVramScanout || kIsGpioFramebuffer;
+
+// Whether the image lines are converted just in time by core 1 into vga_line_ring, and scanned out
+// by dma_handler_vga() - for the VGA, CVBS and DVI modes, and for the Agat-7 mode with
+// -DAGAT7_SCANOUT=stream. Otherwise, unless kIsDirectScanout, the whole Vram is pre-rendered into
+// agat7_dma_bufs[] once.
+constexpr bool kIsLineRingScanout = !kIsDirectScanout
+    && (Config::kMode == Config::Mode::vga
+        || Config::kMode == Config::Mode::cvbs
+        || Config::kMode == Config::Mode::dvi
+        || Config::kAgat7Scanout == Config::Agat7Scanout::stream);
+
+static_assert(Config::kLineSource == Config::LineSource::vram || kIsLineRingScanout,
+    "Test patterns and the text mode are generated by the line ring scanout only");
+
+// Vram depths other than 4 bits are expanded by Palette only, i.e. in the Agat-7 and PAL modes, and
+// in the VGA mode with -DTIMING=pio; DoubledPalette, the encoders, the PIO unpacking, LinePatterns
+// and the Agat-7 picture take 4-bit pixels.
+static_assert(Vram::kBitsPerPixel == 4
+    || (!kIsVramScanout
+        && !is_h_scale_in_vga_conversion(kVideoModeVga640x480x60)
+        && Config::kLineSource == Config::LineSource::vram),
+    "The Vram depth is expanded by Palette only");
+
+// The lines converted by the line ring scanout. The type is chosen at compile time, so that the
+// conversion calls LineBytes() directly, without a virtual call.
+__force_inline auto& line_source() {
+  if constexpr (Config::kLineSource == Config::LineSource::pattern) {
+    return *line_patterns;
+  } else if constexpr (Config::kLineSource == Config::LineSource::text) {
+    return *agat7_text_mode;
+  } else {
+    return std::as_const(*vram);  // The front lines, see Vram::EnableBackBuffer().
+  }
+}
+
+// Image lines of the line ring scanout, converted ahead of the beam by core 1. 2, 4 or 8; each
+// extra line costs a DMA line buffer, i.e. whole_line / h_scale bytes, or whole_line *
+// TmdsEncoder::kBytesPerPixel (6400) with -DMODE=dvi, and lets the conversion run one more line
+// ahead.
+constexpr int kVgaLineRingDepth = 4;
+static LineRing<kVgaLineRingDepth> vga_line_ring;
+static uint32_t vga_late_line_count = 0;  // Image lines shown black because not converted in time.
+
+// The geometry which the line ring scanout latches at the next frame start, see
+// set_scanout_geometry().
+static std::atomic<ScanoutGeometry> scanout_geometry;
+// The line transformed by the geometry, when it is not the horizontal identity.
+static uint32_t scanout_geometry_line[Vram::kStride / 4];
 
 static uint32_t* agat7_dma_bufs[256];  // One buffer per line.
 
+// With -DSECOND_OUTPUT=agat7, agat7_dma_bufs[] and agat7_frame_dma_bufs[] are scanned out by the
+// second output, in the Agat-7 mode with its own palette, while the main output shows the VGA
+// mode; otherwise, they are of the main output.
+constexpr bool kIsSecondOutput = Config::kSecondOutput == Config::SecondOutput::agat7;
+static_assert(!kIsSecondOutput || Config::kLineSource == Config::LineSource::vram,
+    "The second output shows the Vram");
+static Palette second_palette;
+static const VideoMode& agat7_video_mode = kIsSecondOutput ? kVideoModeAgat7 : video_mode;
+static const Palette& agat7_palette = kIsSecondOutput ? second_palette : palette;
+
+// The buffers of the vertical blanking lines of the second output, like v_blank_dma_bufs[].
+static uint32_t* second_v_blank_dma_bufs[
+    kVideoModeAgat7.whole_frame - kVideoModeAgat7.v_visible_area];
+
+// For -DAGAT7_SCANOUT=chain: the DMA buffer for each line of the frame, starting with the first
+// line of the vertical blanking, followed by the null entry; with -DTIMING=pio, only the image
+// lines, followed by the null entry. The control DMA channel walks this table by itself; writing
+// the null entry to the data channel trigger register stops the chain, and the only IRQ per frame
+// restarts the table. -DMODE=pal uses it for the whole interlaced frame, both fields.
+static uint32_t* agat7_frame_dma_bufs[kVideoModePal625i.whole_frame + 1];
+
+// For kIsDirectScanout: the framebuffer line for each visible line of the frame, followed by the
+// null entry, walked by the control DMA channel like agat7_frame_dma_bufs[]. With Vram, rebuilt at
+// every vertical blanking, because a Vram flip changes the line addresses.
+static const uint8_t* vram_frame_dma_bufs[kMaxLineMapVisibleArea + 1];
+static const uint32_t black_vram_line[Vram::kStride / 4]{};  // For the black bars.
+
 static int dma_ch0;
 static int dma_ch1;
 
-void __not_in_flash_func(convert_vram_line_to_vga_dma_buf)(
-    const VgaParams& vga_params, uint32_t* dma_buf, const Vram& vram, int vga_y) {
-  uint16_t* dma_buf_word_ptr = (uint16_t*)dma_buf;
+// With -DTIMING=pio: the PIO IRQ flags raised by pio_vga_vsync for the CPU.
+constexpr uint kPioIrqVblank = 0;  // The first line of the vertical blanking.
+constexpr uint kPioIrqFrameStart = 1;  // The last line before the image.
+
+// Filled if -DPROFILE=on.
+static debug::CycleStats dma_handler_cycles;
+static debug::CycleStats vga_line_conversion_cycles;
+
+// The scanout functions below are templates on a catalog VideoMode, so that all the line
+// boundaries and scale factors become compile-time constants; start_vga() picks the RAM-resident
+// instantiation for Config::kMode.
+
+// Expands the given number of Vram words (8 pixels each) via DoubledPalette, 2 words per
+// iteration, with the LUT addresses computed by the CPU.
+__force_inline void expand_vram_words_via_cpu(
+    uint32_t* dma_buf_word_ptr, const uint32_t* vram_word_ptr, int vram_word_count) {
+  for (int i = vram_word_count / 2; i != 0; --i) {
+    const uint32_t vram_word0 = *(vram_word_ptr + 0);
+    const uint32_t vram_word1 = *(vram_word_ptr + 1);
+    *(dma_buf_word_ptr + 0) = doubled_palette[vram_word0 & 0xFF];
+    *(dma_buf_word_ptr + 1) = doubled_palette[(vram_word0 >> 8) & 0xFF];
+    *(dma_buf_word_ptr + 2) = doubled_palette[(vram_word0 >> 16) & 0xFF];
+    *(dma_buf_word_ptr + 3) = doubled_palette[vram_word0 >> 24];
+    *(dma_buf_word_ptr + 4) = doubled_palette[vram_word1 & 0xFF];
+    *(dma_buf_word_ptr + 5) = doubled_palette[(vram_word1 >> 8) & 0xFF];
+    *(dma_buf_word_ptr + 6) = doubled_palette[(vram_word1 >> 16) & 0xFF];
+    *(dma_buf_word_ptr + 7) = doubled_palette[vram_word1 >> 24];
+    vram_word_ptr += 2;
+    dma_buf_word_ptr += 8;
+  }
+  if (vram_word_count % 2 != 0) {
+    const uint32_t vram_word = *vram_word_ptr;
+    *(dma_buf_word_ptr + 0) = doubled_palette[vram_word & 0xFF];
+    *(dma_buf_word_ptr + 1) = doubled_palette[(vram_word >> 8) & 0xFF];
+    *(dma_buf_word_ptr + 2) = doubled_palette[(vram_word >> 16) & 0xFF];
+    *(dma_buf_word_ptr + 3) = doubled_palette[vram_word >> 24];
+  }
+}
+
+// Expands the given number of Vram words (8 pixels each) via DoubledPalette, with the LUT
+// addresses computed by the interpolators of the calling core, see VramInterpLanes. The
+// interpolator state is saved and restored, so the function is safe to call from an IRQ handler
+// and to interrupt.
+__force_inline void expand_vram_words_via_interp(
+    uint32_t* dma_buf_word_ptr, const uint32_t* vram_word_ptr, int vram_word_count) {
+  static_assert(sizeof(doubled_palette[0]) == 4);
+  interp_hw_save_t interp0_state;
+  interp_hw_save_t interp1_state;
+  interp_save(interp0, &interp0_state);
+  interp_save(interp1, &interp1_state);
+
+  for (interp_hw_t* const interp: {interp0, interp1}) {
+    for (int lane = 0; lane < 2; ++lane) {
+      const VramInterpLanes::Lane& lane_config = VramInterpLanes::kLanes[lane];
+      interp_config config = interp_default_config();
+      interp_config_set_shift(&config, lane_config.shift);
+      interp_config_set_mask(&config, lane_config.mask_lsb, lane_config.mask_msb);
+      interp_config_set_cross_input(&config, lane_config.is_cross_input);
+      interp_set_config(interp, lane, &config);
+      interp->base[lane] = (uintptr_t) doubled_palette.data();
+    }
+  }
+
+  for (int i = vram_word_count; i != 0; --i) {
+    const uint32_t vram_word = *vram_word_ptr++;
+    interp0->accum[0] = VramInterpLanes::Accum0(0, vram_word);
+    interp1->accum[0] = VramInterpLanes::Accum0(1, vram_word);
+    *(dma_buf_word_ptr + 0) = *(const uint32_t*) (uintptr_t) interp0->peek[0];
+    *(dma_buf_word_ptr + 1) = *(const uint32_t*) (uintptr_t) interp0->peek[1];
+    *(dma_buf_word_ptr + 2) = *(const uint32_t*) (uintptr_t) interp1->peek[0];
+    *(dma_buf_word_ptr + 3) = *(const uint32_t*) (uintptr_t) interp1->peek[1];
+    dma_buf_word_ptr += 4;
+  }
+
+  interp_restore(interp0, &interp0_state);
+  interp_restore(interp1, &interp1_state);
+}
 
+// Each Vram byte becomes a 32-bit word of four GPIO bytes, including the left and right margins.
+// The Vram line is read with aligned 32-bit loads; Config::kLineConversion chooses how the LUT
+// addresses are computed.
+void __not_in_flash_func(convert_vram_line_to_doubled_pixels)(
+    const VgaParams& vga_params, uint32_t* dma_buf_word_ptr, Span<const uint8_t> vram_line_bytes) {
   // Left margin.
   for (int i = vga_params.h_margin / /* two pixels */ 2; i != 0; --i) {
-    *dma_buf_word_ptr++ = palette[0];
+    *dma_buf_word_ptr++ = doubled_palette[0];
   }
 
-  ASSERT_CMP(vga_y, >=, vga_params.v_margin);
-  const auto vram_line_bytes = vram.LineBytes((vga_y - vga_params.v_margin) / video_mode.v_scale);
+  const int vram_line_size = vga_params.h_visible_area / /* two pixels */ 2;
+  ASSERT_CMP(vram_line_size, <=, vram_line_bytes.size());
+  ASSERT_CMP((uintptr_t) vram_line_bytes.data(), % 4 ==, 0u);
+  const uint32_t* vram_word_ptr = (const uint32_t*) vram_line_bytes.data();
+  const int vram_word_count = vram_line_size / 4;
+  switch (Config::kLineConversion) {
+    case Config::LineConversion::cpu: {
+      expand_vram_words_via_cpu(dma_buf_word_ptr, vram_word_ptr, vram_word_count);
+    } break;
+    case Config::LineConversion::interp: {
+      expand_vram_words_via_interp(dma_buf_word_ptr, vram_word_ptr, vram_word_count);
+    } break;
+  }
+  dma_buf_word_ptr += vram_word_count * 4;
+  const uint8_t* vram_byte_ptr = (const uint8_t*) (vram_word_ptr + vram_word_count);
+  for (int i = vram_line_size % 4; i != 0; --i) {
+    *dma_buf_word_ptr++ = doubled_palette[*vram_byte_ptr++];
+  }
+
+  // Right margin.
+  for (int i = vga_params.h_margin / /* two pixels */ 2; i != 0; --i) {
+    *dma_buf_word_ptr++ = doubled_palette[0];
+  }
+}
+
+template <const VideoMode& kMode>
+void __not_in_flash_func(convert_vram_line_to_vga_dma_buf)(
+    const VgaParams& vga_params, uint32_t* dma_buf, Span<const uint8_t> vram_line_bytes) {
+  if constexpr (is_h_scale_in_vga_conversion(kMode)) {
+    convert_vram_line_to_doubled_pixels(vga_params, dma_buf, vram_line_bytes);
+    return;
+  }
+
+  // The pixels of a Vram byte at a time.
+  Palette::Pixels* dma_buf_word_ptr = (Palette::Pixels*)dma_buf;
+  ASSERT_CMP(vga_params.h_margin, % Vram::kPixelsPerByte ==, 0);
+
+  // Left margin.
+  for (int i = vga_params.h_margin / Vram::kPixelsPerByte; i != 0; --i) {
+    *dma_buf_word_ptr++ = palette[0];
+  }
 
 // TODO: Investigate whether the new safe C++-style algorithm lowers performance.
 #if 1  // Optimized unsafe C-style algorithm.
   const uint8_t* vram_byte_ptr = &vram_line_bytes[0];
   int vram_x = 0;
-  while (vram_x + 8 <= vga_params.h_visible_area) {
+  while (vram_x + 4 * Vram::kPixelsPerByte <= vga_params.h_visible_area) {
     *dma_buf_word_ptr++ = palette[*(vram_byte_ptr + 0)];
     *dma_buf_word_ptr++ = palette[*(vram_byte_ptr + 1)];
     *dma_buf_word_ptr++ = palette[*(vram_byte_ptr + 2)];
     *dma_buf_word_ptr++ = palette[*(vram_byte_ptr + 3)];
     vram_byte_ptr += 4;
-    vram_x += 8;
+    vram_x += 4 * Vram::kPixelsPerByte;
   }
   while (vram_x < vga_params.h_visible_area) {
     *dma_buf_word_ptr++ = palette[*vram_byte_ptr++];
-    vram_x += 4;
+    vram_x += Vram::kPixelsPerByte;
   }
 #elif 0  // Safe naive algorithm using Span::operator[] - requires disabling the assertion in Span.
-  for (int vram_byte_idx = 0; vram_byte_idx < vga_params.h_visible_area / 2; ++vram_byte_idx) {
+  for (int vram_byte_idx = 0; vram_byte_idx < vga_params.h_visible_area / Vram::kPixelsPerByte;
+      ++vram_byte_idx) {
     *dma_buf_word_ptr++ = palette[vram_line_bytes[vram_byte_idx]];
   }
 #else  // Safe C++-style algorithm using Span::CopyTo() - requires disabling the assertion in Span.
@@ -250,145 +732,698 @@ void __not_in_flash_func(convert_vram_line_to_vga_dma_buf)(
 #endif
 
   // Right margin.
-  for (int i = vga_params.h_margin / /* two pixels */ 2; i != 0; --i) {
+  for (int i = vga_params.h_margin / Vram::kPixelsPerByte; i != 0; --i) {
     *dma_buf_word_ptr++ = palette[0];
   }
 }
 
-void __not_in_flash_func(dma_handler_vga)() {
-  // VGA monitor line: 0..video_mode.whole_frame. Visible lines start at 0, vsync lines follow.
-  static uint16_t y = 0;
+// The line of line_source() shown as its line y, with the geometry applied: the vertical part picks
+// the source line, and the horizontal part transforms the line into scanout_geometry_line[].
+__force_inline Span<const uint8_t> scanout_line_bytes(const ScanoutGeometry& geometry, int y) {
+  const auto line_bytes = line_source().LineBytes(geometry.SourceLine(y, line_source().height()));
+  if (geometry.IsHorzIdentity()) {
+    return line_bytes;
+  }
+  geometry.TransformLine(scanout_geometry_line, line_bytes);
+  return {(const uint8_t*) scanout_geometry_line, line_bytes.size()};
+}
 
-  dma_hw->ints0 = 1u << dma_ch1;
+// Core 1 entry point for the VGA mode: converts the Vram lines of each frame, in the scan order,
+// into the line ring as soon as a slot is free, so that the DMA IRQ on core 0 only hands the
+// converted buffers over to the DMA.
+template <const VideoMode& kMode>
+void __not_in_flash_func(vga_line_producer)() {
+  if constexpr (Config::kProfile == Config::Profile::on) {
+    debug::CycleStats::StartSysTick();
+  }
+  int seq = 0;  // Sequence number within the frame, in sync with the free-running one.
+  ScanoutGeometry geometry;  // Latched at the frame start.
+  for (;;) {
+    if (!vga_line_ring.CanProduce()) {
+      tight_loop_contents();
+      continue;
+    }
+    if (seq == 0 && !vga_line_ring.IsAllReleased()) {
+      // Start the frame after the vertical blanking has started, so that it shows the Vram lines
+      // as of the latest flip.
+      tight_loop_contents();
+      continue;
+    }
+    if (seq == 0) {
+      geometry = scanout_geometry.load(std::memory_order_acquire);
+    }
+    seq = (seq + vga_line_ring.SkipReleased()) % vga_seq_count;
+    {
+      debug::ScopedCycleMeter cycle_meter(vga_line_conversion_cycles);
+      if constexpr (Config::kMode == Config::Mode::cvbs) {
+        cvbs_encoder.EncodeLine((uint8_t*) vga_line_ring.ProducerSlot(),
+            /*y*/ vga_params.v_margin + seq,
+            scanout_line_bytes(geometry, vga_seq_vram_lines[seq]));
+      } else if constexpr (Config::kMode == Config::Mode::dvi) {
+        // Core 0 encodes the right half meanwhile, see sio_handler_tmds_right_halves().
+        const auto vram_line_bytes = scanout_line_bytes(geometry, vga_seq_vram_lines[seq]);
+        ASSERT_CMP(vram_line_bytes.size(), ==, vga_params.h_visible_area / 2);
+        const int half_size = vram_line_bytes.size() / 2;
+        uint32_t* const slot = vga_line_ring.ProducerSlot();
+        multicore_fifo_push_blocking((uintptr_t) slot);
+        multicore_fifo_push_blocking((uintptr_t) (vram_line_bytes.data() + half_size));
+        tmds_encoder.EncodeLine(slot, {vram_line_bytes.data(), half_size}, /*first_vram_byte*/ 0);
+        multicore_fifo_pop_blocking();  // Core 0 has finished its half.
+      } else {
+        convert_vram_line_to_vga_dma_buf<kMode>(
+            vga_params,
+            vga_line_ring.ProducerSlot(),
+            scanout_line_bytes(geometry, vga_seq_vram_lines[seq]));
+      }
+    }
+    vga_line_ring.Produce();
+    if (++seq == vga_seq_count) {
+      seq = 0;
+    }
+  }
+}
+
+// Sets the geometry which the line ring scanout applies from the next frame on, e.g. to show the
+// same picture mirrored or scrolled for the yoke and geometry checks. Can be called at any time,
+// from either core; the offsets wrap around the picture.
+void set_scanout_geometry(ScanoutGeometry geometry) {
+  ASSERT(kIsLineRingScanout, "The scanout geometry is applied by the line ring scanout only");
+  ASSERT(Vram::kBitsPerPixel == 4 || geometry.IsHorzIdentity(),
+      "The horizontal geometry takes 4-bit pixels");
+  geometry.x_offset = geometry.x_offset % line_source().width_px();
+  geometry.y_offset = geometry.y_offset % line_source().height();
+  scanout_geometry.store(geometry, std::memory_order_release);
+}
 
-  ++y;
-  if (y == video_mode.whole_frame) {
-    y = 0;
+// Serves the scanout geometry commands typed on the stdio until end_us: 'm' mirrors, 'f' flips,
+// 'h', 'l', 'k' and 'j' scroll left, right, up and down by 8 pixels or lines, '0' resets.
+void serve_scanout_geometry_commands(uint32_t end_us) {
+  constexpr int kScrollStep = 8;
+  for (int32_t remaining_us; (remaining_us = (int32_t) (end_us - time_us_32())) > 0;) {
+    const int c = getchar_timeout_us((uint32_t) remaining_us);
+    if (c == PICO_ERROR_TIMEOUT) {
+      return;
+    }
+    ScanoutGeometry geometry = scanout_geometry.load(std::memory_order_relaxed);
+    const bool is_horz_command = c == 'm' || c == 'h' || c == 'l';
+    if (is_horz_command && Vram::kBitsPerPixel != 4) {
+      printf("The horizontal geometry takes 4-bit pixels.\n");
+      continue;
+    }
+    // The offsets wrap around in set_scanout_geometry(); adding the size keeps them positive.
+    switch (c) {
+      case 'm': geometry.is_h_mirrored = !geometry.is_h_mirrored; break;
+      case 'f': geometry.is_v_flipped = !geometry.is_v_flipped; break;
+      case 'h': geometry.x_offset = geometry.x_offset + kScrollStep; break;
+      case 'l': geometry.x_offset = geometry.x_offset + line_source().width_px() - kScrollStep; break;
+      case 'k': geometry.y_offset = geometry.y_offset + kScrollStep; break;
+      case 'j': geometry.y_offset = geometry.y_offset + line_source().height() - kScrollStep; break;
+      case '0': geometry = {}; break;
+      default: continue;
+    }
+    set_scanout_geometry(geometry);
+    geometry = scanout_geometry.load(std::memory_order_relaxed);
+    printf("Scanout geometry: x_offset %d, y_offset %d%s%s\n", (int) geometry.x_offset,
+        (int) geometry.y_offset, geometry.is_h_mirrored ? ", mirrored" : "",
+        geometry.is_v_flipped ? ", flipped" : "");
   }
+}
 
-  if (y >= video_mode.v_visible_area
-      && y < (video_mode.v_visible_area + video_mode.v_front_porch)) {
-    // vertical sync front porch
-    dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufBlank], false);
-    return;
+// Core 0 part of the line producer with -DMODE=dvi: encodes the right half of each line which
+// vga_line_producer() on core 1 hands over via the inter-core FIFO, so that the TMDS encoding is
+// split between the cores. Runs on the FIFO IRQ at the lowest priority, so that it is preempted
+// by the DMA IRQ of the scanout, and core 1 is served whatever the main loop does.
+void __not_in_flash_func(sio_handler_tmds_right_halves)() {
+  const int vram_line_size = vga_params.h_visible_area / 2;
+  const int half_size = vram_line_size / 2;
+  while (multicore_fifo_rvalid()) {
+    uint32_t* const slot = (uint32_t*) (uintptr_t) multicore_fifo_pop_blocking();
+    const uint8_t* const right_half = (const uint8_t*) (uintptr_t) multicore_fifo_pop_blocking();
+    tmds_encoder.EncodeLine(slot, {right_half, vram_line_size - half_size}, half_size);
+    multicore_fifo_push_blocking(0);
   }
-  if (y >= (video_mode.v_visible_area + video_mode.v_front_porch)
-      && y < (video_mode.v_visible_area + video_mode.v_front_porch + video_mode.v_sync_pulse)) {
-    // vertical sync pulse
-    dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufVsync], false);
-    return;
+  multicore_fifo_clear_irq();
+}
+
+// State of the line ring scanout, shared by dma_handler_vga() and pio_handler_vga().
+static struct {
+  // VGA monitor line: 0..whole_frame. Visible lines start at 0, vsync lines follow. With
+  // -DTIMING=pio, only the visible lines are counted, because only they go through the DMA.
+  uint16_t y = 0;
+  // Free-running sequence number of the first line of the current frame in the line ring.
+  uint32_t frame_seq = 0;
+  // Whether the line armed by the previous call, thus being read by the DMA now, is in the ring.
+  bool is_scanning_ring = false;
+  uint32_t scanned_seq = 0;
+} vga_scan;
+
+// Called when the DMA has finished with the last image line.
+__force_inline void end_vga_frame() {
+  vga_scan.is_scanning_ring = false;
+  if constexpr (Config::kLineSource == Config::LineSource::vram) {
+    vram->OnVblank();
   }
-  if (y >= (video_mode.v_visible_area + video_mode.v_front_porch + video_mode.v_sync_pulse)
-      && y < video_mode.whole_frame) {
-    // vertical sync back porch
-    dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufBlank], false);
-    return;
+  vga_scan.frame_seq += vga_seq_count;
+  vga_line_ring.ReleaseBefore(vga_scan.frame_seq);  // Let the producer prepare the next frame.
+}
+
+// Returns the address of the DMA buffer pointer for the visible line y, to be given to the
+// control DMA channel.
+__force_inline uint32_t* const* arm_vga_visible_line(int y) {
+  if (vga_scan.is_scanning_ring) {
+    vga_line_ring.ReleaseBefore(vga_scan.scanned_seq);
   }
 
-  // Top and bottom black bars when the vertical size of the image is smaller than the vertical
-  // resolution of the screen.
-  if (y < vga_params.v_margin || y >= (vga_params.v_visible_area + vga_params.v_margin)) {
-    dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufBlank], false);
-    return;
+  const int frame_line_seq = vga_line_seqs[y];
+  if (frame_line_seq < 0) {
+    // Top and bottom black bars when the vertical size of the image is smaller than the vertical
+    // resolution of the screen.
+    vga_scan.is_scanning_ring = false;
+    return &dma_bufs[blank_dma_buf_index(y)];
   }
 
   // Image area.
-  ASSERT_CMP(video_mode.v_scale, ==, 2);  // TODO: Support other scales.
-  int active_buf_idx = -1;
-  switch (y % 4) {
-    case 0: {
-      active_buf_idx = kDmaBufImageA;
-      break;
-    }
-    case 1: {
-      dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufImageA], false);
+  const uint32_t seq = vga_scan.frame_seq + frame_line_seq;
+  if (!vga_line_ring.IsProduced(seq)) {
+    ++vga_late_line_count;
+    vga_scan.is_scanning_ring = false;
+    return &dma_bufs[blank_dma_buf_index(y)];
+  }
+  vga_scan.is_scanning_ring = true;
+  vga_scan.scanned_seq = seq;
+  return vga_line_ring.SlotPtr(seq);
+}
+
+template <const VideoMode& kMode>
+void __not_in_flash_func(dma_handler_vga)() {
+  static_assert(kMode.v_visible_area <= std::size(vga_line_seqs));
+  static_assert(kMode.v_front_porch >= 2, "Needed to release the line ring between frames");
+  static_assert(kMode.whole_frame - kMode.v_visible_area <= std::size(v_blank_dma_bufs));
+
+  debug::ScopedCycleMeter cycle_meter(dma_handler_cycles);
+  dma_hw->ints0 = 1u << dma_ch1;
+
+  const int y = ++vga_scan.y;
+
+  if constexpr (Config::kTiming == Config::Timing::pio) {
+    // After the last visible line, stop until pio_handler_vga() restarts the frame. ch1 raises the
+    // IRQ for the null entry too, when there is no line to arm.
+    if (y > kMode.v_visible_area) {
       return;
-    };
-    case 2: {
-      active_buf_idx = kDmaBufImageB;
-      break;
     }
-    case 3: {
-      dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufImageB], false);
-      return;
+    dma_channel_set_read_addr(dma_ch1,
+        (y == kMode.v_visible_area) ? &null_dma_buf : arm_vga_visible_line(y), false);
+    return;
+  }
+
+  if (y == kMode.whole_frame) {
+    vga_scan.y = 0;
+    dma_channel_set_read_addr(dma_ch1, arm_vga_visible_line(0), false);
+    return;
+  }
+
+  if (y >= kMode.v_visible_area) {
+    if (y == kMode.v_visible_area + 1) {  // The DMA has finished with the last image line.
+      end_vga_frame();
     }
+    // Vertical sync front porch, pulse, or back porch.
+    dma_channel_set_read_addr(dma_ch1, &v_blank_dma_bufs[y - kMode.v_visible_area], false);
+    return;
+  }
+
+  dma_channel_set_read_addr(dma_ch1, arm_vga_visible_line(y), /*triogger=*/false);
+}
+
+// With -DTIMING=pio: handles the IRQs raised by pio_vga_vsync for the CPU.
+void __not_in_flash_func(pio_handler_vga)() {
+  debug::ScopedCycleMeter cycle_meter(dma_handler_cycles);
+  if (pio_interrupt_get(pio0, kPioIrqVblank)) {
+    pio_interrupt_clear(pio0, kPioIrqVblank);
+    end_vga_frame();
+  }
+  if (pio_interrupt_get(pio0, kPioIrqFrameStart)) {
+    pio_interrupt_clear(pio0, kPioIrqFrameStart);
+    vga_scan.y = 0;
+    dma_channel_set_read_addr(dma_ch1, arm_vga_visible_line(0), /*trigger=*/true);
   }
+}
 
-  convert_vram_line_to_vga_dma_buf(vga_params, dma_bufs[active_buf_idx], vram, y);
-  dma_channel_set_read_addr(dma_ch1, &dma_bufs[active_buf_idx], /*triogger=*/false);
+void __not_in_flash_func(convert_vram_line_to_agat7_dma_buf)(int y) {
+  const VideoMode& video_mode = agat7_video_mode;  // Of the main or the second output.
+  const Palette& palette = agat7_palette;
+  const auto vram_line_bytes = std::as_const(*vram).LineBytes(y);  // Keeps the dirty mark.
+  // Centered in the visible area, which is wider in the PAL mode; the pixels of a Vram byte at a
+  // time.
+  Palette::Pixels* const line_buf = (Palette::Pixels*)agat7_dma_bufs[y]
+      + (video_mode.h_visible_area - Vram::kWidthPx) / 2 / Vram::kPixelsPerByte;
+  for (int x = 0; x < vram_line_bytes.size(); ++x) {
+    line_buf[x] = palette[vram_line_bytes[x]];
+  }
 }
 
 void prepare_agat7_dma_bufs() {
-  const int whole_line = video_mode.whole_line / video_mode.h_scale;
+  const VideoMode& video_mode = agat7_video_mode;
+  const int line_size = dma_line_size(video_mode);
   const int h_sync_pulse_front =
       (video_mode.h_visible_area + video_mode.h_front_porch) / video_mode.h_scale;
   const int h_sync_pulse = video_mode.h_sync_pulse / video_mode.h_scale;
 
   // Prepare all 256 lines (0..255) from the frame buffer.
   for (int y = 0; y < 256; y++) {
-    agat7_dma_bufs[y] = (uint32_t*)malloc(whole_line);
+    agat7_dma_bufs[y] = (uint32_t*)malloc(line_size);
     uint8_t* line_bytes = (uint8_t*)agat7_dma_bufs[y];
 
     // Fill with the sync pattern.
-    memset(line_bytes, (kNoSyncGpioByte ^ video_mode.sync_polarity), whole_line);
-    memset(line_bytes + h_sync_pulse_front, (kHSyncGpioByte ^ video_mode.sync_polarity), h_sync_pulse);
+    memset(line_bytes, (kNoSyncGpioByte ^ video_mode.sync_polarity), line_size);
+    if (Config::kTiming == Config::Timing::dma) {
+      memset(line_bytes + h_sync_pulse_front,
+          (kHSyncGpioByte ^ video_mode.sync_polarity), h_sync_pulse);
+    }
 
     // Convert the frame buffer line through the palette.
-    const auto vram_line_bytes = vram.LineBytes(y);
-    uint16_t* const line_buf = (uint16_t*)agat7_dma_bufs[y];
-    for (int x = 0; x < vram_line_bytes.size(); ++x) {
-      line_buf[x] = palette[vram_line_bytes[x]];
+    vram->ClearLineDirty(y);
+    convert_vram_line_to_agat7_dma_buf(y);
+  }
+}
+
+// Re-render the Vram lines modified since the previous call into agat7_dma_bufs[]. Must be called
+// during the vertical blanking, after the DMA has finished reading the last visible line. Renders
+// at least one dirty line, and more while the budget lasts; the rest are left for the next call.
+void __not_in_flash_func(refresh_dirty_agat7_dma_bufs)(uint32_t budget_us) {
+  const uint32_t start_us = time_us_32();
+  for (int y = vram->NextDirtyLine(0); y >= 0; y = vram->NextDirtyLine(y + 1)) {
+    // Clear the mark first, so that a modification during the rendering marks the line again.
+    vram->ClearLineDirty(y);
+    convert_vram_line_to_agat7_dma_buf(y);
+    if (time_us_32() - start_us >= budget_us) {
+      return;
     }
   }
 }
 
+// How long the Agat-7 frame chain IRQ may re-render dirty lines: about 2/3 of the vertical
+// blanking, which is 56 lines of 64 us.
+constexpr uint32_t kAgat7RefreshBudgetUs = 2'400;
+
+// The same for the interlaced PAL mode, where the IRQ comes once per frame, at the start of the
+// vertical blanking between the fields, which is 25 lines of 64 us.
+constexpr uint32_t kPal625iRefreshBudgetUs = 1'000;
+
+// Line being armed by dma_handler_agat7(), see vga_scan.y.
+static uint16_t agat7_scan_y = 0;
+
+template <const VideoMode& kMode>
 void __not_in_flash_func(dma_handler_agat7)() {
-  static uint16_t y = 0;
+  static_assert(kMode.v_scale == 1);
+  static_assert(kMode.v_visible_area <= std::size(agat7_dma_bufs));
+  static_assert(kMode.whole_frame - kMode.v_visible_area <= std::size(v_blank_dma_bufs));
 
+  debug::ScopedCycleMeter cycle_meter(dma_handler_cycles);
   dma_hw->ints0 = 1u << dma_ch1;
-  ++y;
-  if (y == video_mode.whole_frame) {
-    y = 0;
+  int y = ++agat7_scan_y;
+
+  if constexpr (Config::kTiming == Config::Timing::pio) {
+    // After the last pixel line, stop until pio_handler_agat7() restarts the frame. ch1 raises
+    // the IRQ for the null entry too, when there is no line to start.
+    if (y > kMode.v_visible_area) {
+      return;
+    }
+    dma_channel_set_read_addr(dma_ch1,
+        (y == kMode.v_visible_area) ? &null_dma_buf : &agat7_dma_bufs[y], false);
+    return;
+  }
+
+  if (y == kMode.whole_frame) {
+    agat7_scan_y = y = 0;
   }
-  if (y >= video_mode.v_visible_area
-      && y < (video_mode.v_visible_area + video_mode.v_front_porch)) {
-    dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufBlank], false);  // Start a V-front-porch.
+  if (y < kMode.v_visible_area) {
+    dma_channel_set_read_addr(dma_ch1, &agat7_dma_bufs[y], false);  // Start a pixel line.
+    return;
   }
-  else if (y >= (video_mode.v_visible_area + video_mode.v_front_porch)
-      && y < (video_mode.v_visible_area + video_mode.v_front_porch + video_mode.v_sync_pulse)) {
-    dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufVsync], false);  // Start a V-sync-pulse.
+  // Start a V-porch or a V-sync-pulse line.
+  dma_channel_set_read_addr(dma_ch1, &v_blank_dma_bufs[y - kMode.v_visible_area], false);
+  if (y == kMode.v_visible_area + 1) {
+    vram->OnVblank();
   }
-  else if (y >= (video_mode.v_visible_area + video_mode.v_front_porch + video_mode.v_sync_pulse)
-    && y < video_mode.whole_frame) {
-    dma_channel_set_read_addr(dma_ch1, &dma_bufs[kDmaBufBlank], false);  // Start a V-back-porch.
+  if (y > kMode.v_visible_area) {  // The DMA has finished with the last pixel line.
+    refresh_dirty_agat7_dma_bufs(/*budget_us=*/0);  // One line per IRQ to keep up with the lines.
   }
-  else if (y < video_mode.v_visible_area) {
-    dma_channel_set_read_addr(dma_ch1, &agat7_dma_bufs[y], false);  // Start a pixel line.
+}
+
+// Fills the DMA buffer of the given blank line of the mode with the GPIO bytes, or with the DAC
+// levels of -DMODE=cvbs.
+void fill_blank_line(
+    const VideoMode& video_mode, uint8_t* line_bytes, const BlankLine& blank_line) {
+  const int line_size = dma_line_size(video_mode);
+  const int h_scale = pio_h_scale(video_mode);
+  const int h_sync_pulse_front = (video_mode.h_visible_area + video_mode.h_front_porch) / h_scale;
+  const int h_sync_pulse = video_mode.h_sync_pulse / h_scale;
+  const int half_line = line_size / 2;
+  const int middle_pulse_front = h_sync_pulse_front - half_line;
+  ASSERT_CMP(middle_pulse_front, >=, 0);  // The middle pulse is within the buffer.
+  const auto pulse_width = [&](SyncPulse pulse) {
+    return
+        (pulse == SyncPulse::none) ? 0 :
+        (pulse == SyncPulse::equalizing) ? h_sync_pulse / 2 :
+        (pulse == SyncPulse::broad) ? half_line - h_sync_pulse :
+        h_sync_pulse;
+  };
+
+  const auto fill = [&](int begin, int end, bool is_vsync, bool is_pulse) {
+    if (Config::kMode == Config::Mode::cvbs) {  // DAC levels; no V-sync pin.
+      memset(line_bytes + begin,
+          is_pulse ? CvbsEncoder::kSyncLevel : CvbsEncoder::kBlankLevel, end - begin);
+      return;
+    }
+    const uint8_t gpio_byte = (is_vsync ? kVSyncGpioByte : kNoSyncGpioByte)
+        | (is_pulse ? kHSyncGpioByte : kNoSyncGpioByte);
+    memset(line_bytes + begin, gpio_byte ^ video_mode.sync_polarity, end - begin);
+  };
+  const int parts[]{0, middle_pulse_front, h_sync_pulse_front, line_size};
+  for (int i = 0; i < 3; ++i) {
+    fill(parts[i], parts[i + 1], blank_line.is_vsync[i], /*is_pulse=*/false);
+  }
+
+  // The tail of a broad pulse which started in the previous buffer.
+  const int prev_pulse_tail =
+      h_sync_pulse_front + pulse_width(blank_line.prev_line.start) - line_size;
+  if (prev_pulse_tail > 0) {
+    fill(0, prev_pulse_tail, blank_line.is_vsync[0], /*is_pulse=*/true);
+  }
+  fill(middle_pulse_front, middle_pulse_front + pulse_width(blank_line.prev_line.middle),
+      blank_line.is_vsync[1], /*is_pulse=*/true);
+  fill(h_sync_pulse_front,
+      std::min(h_sync_pulse_front + pulse_width(blank_line.start), line_size),
+      blank_line.is_vsync[2], /*is_pulse=*/true);
+  if (blank_line.burst_line >= 0) {
+    cvbs_encoder.EncodeBurst(line_bytes, blank_line.burst_line);
+  }
+}
+
+// Returns the buffer of dma_bufs[] for the given type and mode, building it when first asked for.
+// Must be called before the scanout starts (-DTIMING=dma only).
+uint32_t* blank_dma_buf(const VideoMode& video_mode, const BlankLine& blank_line) {
+  for (int i = 0; i < dma_buf_count; ++i) {
+    if (dma_buf_blank_lines[i] == blank_line && dma_buf_video_modes[i] == &video_mode) {
+      return dma_bufs[i];
+    }
+  }
+  ASSERT_CMP(dma_buf_count, <, (int) std::size(dma_bufs));
+
+  uint32_t* const dma_buf = (uint32_t*)malloc(dma_line_size(video_mode));
+  if (Config::kMode == Config::Mode::dvi) {
+    // The V-sync state is the same over the whole buffer in a progressive mode.
+    ASSERT(blank_line.is_vsync[0] == blank_line.is_vsync[2]);
+    tmds_encoder.EncodeBlankLine(dma_buf, blank_line.is_vsync[0], blank_line.is_video_period);
+  } else {
+    fill_blank_line(video_mode, (uint8_t*)dma_buf, blank_line);
+  }
+
+  dma_bufs[dma_buf_count] = dma_buf;
+  dma_buf_blank_lines[dma_buf_count] = blank_line;
+  dma_buf_video_modes[dma_buf_count] = &video_mode;
+  ++dma_buf_count;
+  return dma_buf;
+}
+
+// Whether the H-sync pin of the output of the mode carries the composite sync: with
+// -DSYNC_OUTPUT=csync, with -DMODE=cvbs (as DAC levels), and on the second output, which has no
+// V-sync pin.
+bool is_csync_output(const VideoMode& video_mode) {
+  return Config::kSyncOutput == Config::SyncOutput::csync
+      || Config::kMode == Config::Mode::cvbs
+      || (kIsSecondOutput && &video_mode == &kVideoModeAgat7);
+}
+
+// The composite sync line which starts in the DMA buffer of the line y of a progressive mode; y
+// may be -1, meaning the last line of the previous frame.
+CsyncLine csync_line(const VideoMode& video_mode, int y) {
+  if (!is_csync_output(video_mode)) {
+    return kNormalCsyncLine;
+  }
+  const int v_sync_pulse_front = video_mode.v_visible_area + video_mode.v_front_porch;
+  const int v_back_porch_front = v_sync_pulse_front + video_mode.v_sync_pulse;
+  if (y >= v_sync_pulse_front - kCsyncEqualizingLineCount && y < v_sync_pulse_front) {
+    return kEqualizingCsyncLine;
+  }
+  if (y >= v_sync_pulse_front && y < v_back_porch_front) {
+    return kBroadCsyncLine;
+  }
+  if (y >= v_back_porch_front && y < v_back_porch_front + kCsyncEqualizingLineCount) {
+    return kEqualizingCsyncLine;
+  }
+  return kNormalCsyncLine;
+}
+
+// Fills v_blank_dma_bufs[] (or second_v_blank_dma_bufs[]) for a progressive mode (-DTIMING=dma),
+// including the blank line, which is dma_bufs[kDmaBufBlank] for the main output. The buffers are
+// built once, so the composite sync costs no CPU time at the scanout. The V-sync pin is active
+// over the whole buffers of the V-sync-pulse lines.
+void prepare_v_blank_dma_bufs(const VideoMode& video_mode, uint32_t** v_blank_dma_bufs) {
+  if (is_csync_output(video_mode)) {
+    ASSERT_CMP(video_mode.v_front_porch, >, kCsyncEqualizingLineCount);
+    ASSERT_CMP(video_mode.v_back_porch, >, kCsyncEqualizingLineCount);
+  }
+  if (Config::kMode == Config::Mode::cvbs) {
+    for (int i = 0; i < CvbsEncoder::kLinePhasePeriod; ++i) {
+      BlankLine blank_line = kBlankLine;
+      blank_line.burst_line = i;
+      blank_dma_buf(video_mode, blank_line);  // Becomes dma_bufs[blank_dma_buf_index(i)].
+    }
+  } else {
+    blank_dma_buf(video_mode, kBlankLine);  // Becomes dma_bufs[kDmaBufBlank].
+  }
+  if (Config::kMode == Config::Mode::pal) {
+    return;  // The interlaced frame has its own table, see prepare_pal625i_frame_dma_bufs().
+  }
+
+  const int v_sync_pulse_front = video_mode.v_visible_area + video_mode.v_front_porch;
+  const int v_back_porch_front = v_sync_pulse_front + video_mode.v_sync_pulse;
+  for (int y = video_mode.v_visible_area; y < video_mode.whole_frame; ++y) {
+    const bool is_vsync = y >= v_sync_pulse_front && y < v_back_porch_front;
+    // With -DMODE=cvbs, the lines of the equalizing and broad pulses have no color burst.
+    const bool has_burst =
+        Config::kMode == Config::Mode::cvbs && csync_line(video_mode, y) == kNormalCsyncLine;
+    v_blank_dma_bufs[y - video_mode.v_visible_area] = blank_dma_buf(video_mode, {
+        .prev_line = csync_line(video_mode, y - 1),
+        .start = csync_line(video_mode, y).start,
+        .is_vsync = {is_vsync, is_vsync, is_vsync},
+        .burst_line = (int8_t) (has_burst ? y % CvbsEncoder::kLinePhasePeriod : -1),
+    });
+  }
+}
+
+// The composite sync line of the PAL line n (1..625, each starting at its H-sync pulse), per
+// ITU-R BT.470: field 1 starts with the broad pulses at line 1, field 2 in the middle of line 313.
+CsyncLine pal625i_csync_line(int n) {
+  if ((n >= 1 && n <= 2) || (n >= 314 && n <= 315)) {
+    return kBroadCsyncLine;
+  }
+  if ((n >= 4 && n <= 5) || (n >= 311 && n <= 312) || (n >= 316 && n <= 317) || n >= 624) {
+    return kEqualizingCsyncLine;
+  }
+  switch (n) {
+    case 3: return {SyncPulse::broad, SyncPulse::equalizing};
+    case 313: return {SyncPulse::equalizing, SyncPulse::broad};
+    case 318: return {SyncPulse::equalizing, SyncPulse::none};
+    case 623: return {SyncPulse::hsync, SyncPulse::equalizing};
+    default: return kNormalCsyncLine;
+  }
+}
+
+// The image lines of the fields: the lines whose DMA buffer - which also holds the start of the
+// next line - has only H-sync pulses. Field 2 starts higher on the screen, so its lines come first
+// in the frame: 335, 23, 336, 24, ..., 622, 309; the last frame line (field 1 line 310) is black.
+constexpr int kPal625iField1FirstImageLine = 23;
+constexpr int kPal625iField1LastImageLine = 309;
+constexpr int kPal625iField2FirstImageLine = 335;
+constexpr int kPal625iField2LastImageLine = 622;
+
+// The line of the 576-line interlaced frame shown by the PAL line n, or -1 if n is not an image
+// line.
+int pal625i_frame_line(int n) {
+  if (n >= kPal625iField2FirstImageLine && n <= kPal625iField2LastImageLine) {
+    return (n - kPal625iField2FirstImageLine) * 2;
+  }
+  if (n >= kPal625iField1FirstImageLine && n <= kPal625iField1LastImageLine) {
+    return (n - kPal625iField1FirstImageLine) * 2 + 1;
+  }
+  return -1;
+}
+
+// The Vram line shown on the frame line, or -1 for the black bars, see Config::kInterlace.
+int pal625i_vram_line(int frame_line) {
+  const int image_height = (Config::kInterlace == Config::Interlace::pair)
+      ? Vram::kLineCount * 2 : Vram::kLineCount;
+  const int image_y = frame_line - (kVideoModePal625i.v_visible_area - image_height) / 2;
+  if (frame_line < 0 || image_y < 0 || image_y >= image_height) {
+    return -1;
+  }
+  return (Config::kInterlace == Config::Interlace::pair) ? image_y / 2 : image_y;
+}
+
+// Builds agat7_frame_dma_bufs[] for the interlaced PAL mode: both fields in one table, each line
+// being an Agat-7 line buffer or a blank one of its type, so the DMA walks the whole frame with
+// its half-line timings by itself.
+void prepare_pal625i_frame_dma_bufs() {
+  constexpr int kLineCount = kVideoModePal625i.whole_frame;
+  static_assert(std::size(agat7_frame_dma_bufs) == kLineCount + 1);
+
+  // The V-sync pin is active during the broad pulses, so it is also half a line late in field 2.
+  const auto csync_line = [](int n) {
+    return (Config::kSyncOutput == Config::SyncOutput::csync)
+        ? pal625i_csync_line(n) : kNormalCsyncLine;
+  };
+  // The table starts after the last image line of field 1, so that its end is the start of the
+  // vertical blanking before field 2.
+  for (int i = 0; i < kLineCount; ++i) {
+    const int n = (kPal625iField1LastImageLine + i) % kLineCount + 1;
+    const int vram_y = pal625i_vram_line(pal625i_frame_line(n));
+    if (vram_y >= 0) {
+      agat7_frame_dma_bufs[i] = agat7_dma_bufs[vram_y];
+      continue;
+    }
+    const int next_n = n % kLineCount + 1;
+    const CsyncLine pal_line = pal625i_csync_line(n);
+    const SyncPulse pal_next_start = pal625i_csync_line(next_n).start;
+    agat7_frame_dma_bufs[i] = blank_dma_buf(video_mode, {
+        .prev_line = csync_line(n),
+        .start = csync_line(next_n).start,
+        .is_vsync = {
+            pal_line.start == SyncPulse::broad,
+            pal_line.middle == SyncPulse::broad,
+            pal_next_start == SyncPulse::broad,
+        },
+    });
+  }
+  agat7_frame_dma_bufs[kLineCount] = nullptr;  // Null trigger - the end of the frame.
+}
+
+void prepare_agat7_frame_dma_bufs() {
+  if (Config::kMode == Config::Mode::pal) {
+    prepare_pal625i_frame_dma_bufs();
+    return;
+  }
+  const VideoMode& video_mode = agat7_video_mode;
+  ASSERT_CMP(video_mode.whole_frame, ==, kVideoModeAgat7.whole_frame);
+  if (Config::kTiming == Config::Timing::pio) {
+    for (int y = 0; y < video_mode.v_visible_area; ++y) {
+      agat7_frame_dma_bufs[y] = agat7_dma_bufs[y];
+    }
+    agat7_frame_dma_bufs[video_mode.v_visible_area] = nullptr;  // Null trigger - frame end.
+    return;
+  }
+
+  // The table starts with the V-front-porch, so that its end is the start of the vertical
+  // blanking.
+  for (int i = 0; i < video_mode.whole_frame; ++i) {
+    const int y = (video_mode.v_visible_area + i) % video_mode.whole_frame;
+    if (y < video_mode.v_visible_area) {
+      agat7_frame_dma_bufs[i] = agat7_dma_bufs[y];  // Pixel line.
+    } else {
+      // V-front-porch, V-sync-pulse, or V-back-porch.
+      agat7_frame_dma_bufs[i] = (kIsSecondOutput ? second_v_blank_dma_bufs : v_blank_dma_bufs)[
+          y - video_mode.v_visible_area];
+    }
+  }
+  agat7_frame_dma_bufs[video_mode.whole_frame] = nullptr;  // Null trigger - the end of the frame.
+}
+
+// Called once per frame, when the control channel has written the null entry of
+// agat7_frame_dma_bufs[], i.e. at the start of the vertical blanking. The data channel has just
+// finished the last line, but the PIO TX FIFO still holds 8 words, which is much longer than the
+// IRQ latency, so the restart causes no gap. Then, while the blank lines are being scanned out,
+// re-renders the dirty lines.
+void __not_in_flash_func(dma_handler_agat7_frame)() {
+  debug::ScopedCycleMeter cycle_meter(dma_handler_cycles);
+  dma_hw->ints0 = 1u << dma_ch0;
+  dma_channel_set_read_addr(dma_ch1, &agat7_frame_dma_bufs[0], /*trigger=*/true);
+  vram->OnVblank();
+  refresh_dirty_agat7_dma_bufs(
+      (Config::kMode == Config::Mode::pal) ? kPal625iRefreshBudgetUs : kAgat7RefreshBudgetUs);
+}
+
+// With -DTIMING=pio: handles the IRQs raised by pio_vga_vsync for the CPU. The DMA is stopped
+// during the vertical blanking, so the dirty lines can be re-rendered until the frame start.
+void __not_in_flash_func(pio_handler_agat7)() {
+  debug::ScopedCycleMeter cycle_meter(dma_handler_cycles);
+  if (pio_interrupt_get(pio0, kPioIrqVblank)) {
+    pio_interrupt_clear(pio0, kPioIrqVblank);
+    vram->OnVblank();
+    refresh_dirty_agat7_dma_bufs(kAgat7RefreshBudgetUs);
+  }
+  if (pio_interrupt_get(pio0, kPioIrqFrameStart)) {
+    pio_interrupt_clear(pio0, kPioIrqFrameStart);
+    if (Config::kAgat7Scanout == Config::Agat7Scanout::chain) {
+      dma_channel_set_read_addr(dma_ch1, &agat7_frame_dma_bufs[0], /*trigger=*/true);
+    } else {
+      agat7_scan_y = 0;
+      dma_channel_set_read_addr(dma_ch1, &agat7_dma_bufs[0], /*trigger=*/true);
+    }
+  }
+}
+
+void __not_in_flash_func(prepare_vram_frame_dma_bufs)() {
+  for (int y = 0; y < video_mode.v_visible_area; ++y) {
+    const int frame_line_seq = vga_line_seqs[y];
+    vram_frame_dma_bufs[y] = (frame_line_seq < 0)
+        ? (const uint8_t*) black_vram_line
+        : std::as_const(*vram).LineBytes(vga_seq_vram_lines[frame_line_seq]).data();
+  }
+  vram_frame_dma_bufs[video_mode.v_visible_area] = nullptr;  // Null trigger - the end of the frame.
+}
+
+// For kIsGpioFramebuffer: the frame table never changes, because each line of the frame shows the
+// line of gpio_framebuffer at the same place scaled.
+void prepare_gpio_frame_dma_bufs() {
+  ASSERT_CMP(gpio_framebuffer->height() * video_mode.v_scale, ==, video_mode.v_visible_area);
+  for (int y = 0; y < video_mode.v_visible_area; ++y) {
+    vram_frame_dma_bufs[y] =
+        std::as_const(*gpio_framebuffer).LineBytes(y / video_mode.v_scale).data();
+  }
+  vram_frame_dma_bufs[video_mode.v_visible_area] = nullptr;  // Null trigger - the end of the frame.
+}
+
+// For kIsDirectScanout: handles the IRQs raised by pio_vga_vsync for the CPU.
+void __not_in_flash_func(pio_handler_vram)() {
+  debug::ScopedCycleMeter cycle_meter(dma_handler_cycles);
+  if (pio_interrupt_get(pio0, kPioIrqVblank)) {
+    pio_interrupt_clear(pio0, kPioIrqVblank);
+    if constexpr (kIsVramScanout) {
+      vram->OnVblank();
+      prepare_vram_frame_dma_bufs();
+    }
+  }
+  if (pio_interrupt_get(pio0, kPioIrqFrameStart)) {
+    pio_interrupt_clear(pio0, kPioIrqFrameStart);
+    dma_channel_set_read_addr(dma_ch1, &vram_frame_dma_bufs[0], /*trigger=*/true);
   }
 }
 
-VgaParams calc_vga_params(const VideoMode& video_mode, const Vram& vram) {
-  ASSERT_CMP(vram.height(), % 2 ==, 0);
-  ASSERT_CMP(vram.width_px(), % 4 ==, 0);
+// The line sources have the size of the Vram.
+VgaParams calc_vga_params(const VideoMode& video_mode) {
+  static_assert(Vram::kLineCount % 2 == 0);
+  static_assert(Vram::kWidthPx % 4 == 0);
   ASSERT_CMP(video_mode.v_visible_area, % 2 ==, 0);
-  ASSERT_CMP(video_mode.v_visible_area, % video_mode.v_scale ==, 0);
+  ASSERT_CMP(video_mode.v_scale, <=, 4);
   ASSERT_CMP(video_mode.h_visible_area, % 2 ==, 0);
   ASSERT_CMP(video_mode.h_visible_area, % video_mode.h_scale ==, 0);
-  ASSERT_CMP(vram.width_px() * video_mode.h_scale, <=, video_mode.h_visible_area);
+  ASSERT_CMP(Vram::kWidthPx * video_mode.h_scale, <=, video_mode.h_visible_area);
 
   VgaParams r;
 
-  r.h_visible_area = vram.width_px();
-  r.h_margin = (video_mode.h_visible_area / video_mode.h_scale - vram.width_px()) / 2;
+  r.h_visible_area = Vram::kWidthPx;
+  r.h_margin = (video_mode.h_visible_area / video_mode.h_scale - Vram::kWidthPx) / 2;
 
-  r.v_visible_area = vram.height() * video_mode.v_scale;
-  if (r.v_visible_area > video_mode.v_visible_area) {  // Truncate the bottom part of the image.
+  if (video_mode.v_scale == VideoMode::kScaleToFit) {
     r.v_visible_area = video_mode.v_visible_area;
+  } else {
+    r.v_visible_area = Vram::kLineCount * video_mode.v_scale;
+    if (r.v_visible_area > video_mode.v_visible_area) {  // Truncate the bottom part of the image.
+      r.v_visible_area = video_mode.v_visible_area;
+    }
   }
-  r.v_margin = (video_mode.v_visible_area / video_mode.v_scale - vram.height()) / 2;
-  if (r.v_margin < 0) {
-    r.v_margin = 0;
-  }
+  r.v_margin = (video_mode.v_visible_area - r.v_visible_area) / 2;
 
   printf("VgaParams{.h_visible_area = %d, .h_margin = %d, .v_visible_area = %d, .v_margin = %d}\n",
       r.h_visible_area, r.h_margin, r.v_visible_area, r.v_margin);
@@ -396,30 +1431,177 @@ VgaParams calc_vga_params(const VideoMode& video_mode, const Vram& vram) {
   return r;
 }
 
+void prepare_vga_line_map(const VideoMode& video_mode, const VgaParams& vga_params) {
+  ASSERT_CMP(video_mode.v_visible_area, <=, std::size(vga_line_seqs));
+
+  vga_seq_count = 0;
+  for (int y = 0; y < video_mode.v_visible_area; ++y) {
+    const int image_y = y - vga_params.v_margin;
+    if (image_y < 0 || image_y >= vga_params.v_visible_area) {
+      vga_line_seqs[y] = -1;
+      continue;
+    }
+    const int vram_y = (video_mode.v_scale == VideoMode::kScaleToFit)
+        ? image_y * Vram::kLineCount / vga_params.v_visible_area
+        : image_y / video_mode.v_scale;
+    if (vga_seq_count == 0 || vga_seq_vram_lines[vga_seq_count - 1] != vram_y) {
+      vga_seq_vram_lines[vga_seq_count++] = vram_y;
+    }
+    vga_line_seqs[y] = vga_seq_count - 1;
+  }
+}
+
+// The DMA IRQ handler for the scanouts which arm the DMA buffer of each next line.
+irq_handler_t line_dma_handler() {
+  if (Config::kMode == Config::Mode::vga || Config::kMode == Config::Mode::dvi) {
+    return dma_handler_vga<kVideoModeVga640x480x60>;
+  }
+  if (Config::kMode == Config::Mode::cvbs) {
+    return dma_handler_vga<kVideoModeCvbs>;
+  }
+  return kIsLineRingScanout ? dma_handler_vga<kVideoModeAgat7> : dma_handler_agat7<kVideoModeAgat7>;
+}
+
+// The PIO and the state machine of the main output.
+const PIO kRgbGenPio = pio0_hw;
+constexpr uint kStateMachine = 0;
+
+// With -DTIMING=pio: the state machines of pio_vga_hsync and pio_vga_vsync; pio_vga_pixels (or
+// pio_vga_nibbles) uses the one which pio_vga uses otherwise.
+constexpr uint kHSyncStateMachine = 1;
+constexpr uint kVSyncStateMachine = 2;
+
+// Cycles from pio_vga_hsync raising IRQ 4 to the first pixel of pio_vga_pixels (or to the left
+// margin of pio_vga_nibbles): the IRQ is relayed by pio_vga_vsync as IRQ 5. pio_vga_hsync raises
+// IRQ 4 this much before the end of the back porch, so that the image starts right after it.
+constexpr int kPioImageStartDelay = kIsVramScanout ? 6 : 4;
+
+// Loads the program with its pixel loop at `pixel_offset` repeating each pixel h_scale times, see
+// add_pixel_repetition(). Return the offset of the loaded program.
+uint add_pio_program_with_pixel_repetition(
+    PIO pio, const pio_program_t& program, uint pixel_offset, int h_scale) {
+  uint16_t instructions[32];
+  memcpy(instructions, program.instructions, program.length * sizeof(instructions[0]));
+  add_pixel_repetition(instructions, pixel_offset, h_scale);
+  pio_program_t repeating_program = program;
+  repeating_program.instructions = instructions;
+  return pio_add_program(pio, &repeating_program);
+}
+
+// Loads the -DTIMING=pio programs, and initializes their state machines, leaving them disabled.
+// Each state machine is given its counters by executing the instructions which pull them from
+// the TX FIFO into its registers.
+void init_pio_timing(PIO pio, uint pixel_state_machine, uint rgbhv_gpio_start, int h_scale) {
+  // All programs count 2 cycles per native pixel; pio_vga_pixels repeats each pixel h_scale times.
+  const float clkdiv = (float)clock_get_hz(clk_sys) / video_mode.pixel_freq / 2;
+  const auto cycles = [](int pixels) { return pixels * 2; };
+  const auto load = [pio](uint state_machine, uint32_t value, pio_src_dest register_) {
+    pio_sm_put_blocking(pio, state_machine, value);
+    pio_sm_exec(pio, state_machine, pio_encode_pull(/*if_empty=*/false, /*block=*/true));
+    if (register_ != pio_osr) {
+      pio_sm_exec(pio, state_machine, pio_encode_mov(register_, pio_osr));
+    }
+  };
+
+  if (kIsVramScanout) {
+    const uint nibbles_offset = add_pio_program_with_pixel_repetition(
+        pio, pio_vga_nibbles_program, pio_vga_nibbles_offset_pixel, h_scale);
+    pio_sm_config nibbles_config = pio_vga_nibbles_program_get_default_config(nibbles_offset);
+    sm_config_set_out_pins(&nibbles_config, rgbhv_gpio_start, /*Vram::Color bits*/ 4);
+    sm_config_set_out_shift(&nibbles_config, true, true, 32);
+    sm_config_set_fifo_join(&nibbles_config, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv(&nibbles_config, clkdiv);
+    pio_sm_init(pio, pixel_state_machine, nibbles_offset, &nibbles_config);
+    load(pixel_state_machine, vga_params.h_visible_area - 1, pio_y);
+    load(pixel_state_machine, cycles(vga_params.h_margin * h_scale), pio_isr);
+  } else {
+    const uint pixels_offset = add_pio_program_with_pixel_repetition(
+        pio, pio_vga_pixels_program, pio_vga_pixels_offset_pixel, h_scale);
+    pio_sm_config pixels_config = pio_vga_pixels_program_get_default_config(pixels_offset);
+    sm_config_set_out_pins(&pixels_config, rgbhv_gpio_start, kRgbGpioCount);
+    sm_config_set_out_shift(&pixels_config, true, true, 32);
+    sm_config_set_fifo_join(&pixels_config, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv(&pixels_config, clkdiv);
+    pio_sm_init(pio, pixel_state_machine, pixels_offset, &pixels_config);
+    load(pixel_state_machine, video_mode.h_visible_area / h_scale - 1, pio_y);
+  }
+  // Empty the OSR, so that the first pixel is autopulled from the DMA data.
+  pio_sm_exec(pio, pixel_state_machine, pio_encode_out(pio_null, 32));
+
+  ASSERT_CMP(cycles(video_mode.h_back_porch), >=, kPioImageStartDelay + 2);
+  const uint hsync_offset = pio_add_program(pio, &pio_vga_hsync_program);
+  pio_sm_config hsync_config = pio_vga_hsync_program_get_default_config(hsync_offset);
+  sm_config_set_sideset_pins(&hsync_config, rgbhv_gpio_start + kHSyncGpioShift);
+  sm_config_set_clkdiv(&hsync_config, clkdiv);
+  pio_sm_init(pio, kHSyncStateMachine, hsync_offset, &hsync_config);
+  load(kHSyncStateMachine, cycles(video_mode.h_sync_pulse) - 2, pio_y);
+  load(kHSyncStateMachine, cycles(video_mode.h_back_porch) - kPioImageStartDelay - 2, pio_isr);
+  load(kHSyncStateMachine,
+      cycles(video_mode.h_visible_area + video_mode.h_front_porch) + kPioImageStartDelay - 3,
+      pio_osr);
+
+  ASSERT_CMP(video_mode.v_visible_area, <=, 1 << 10);
+  ASSERT_CMP(video_mode.v_front_porch, >=, 2);
+  ASSERT_CMP(video_mode.v_sync_pulse, >=, 1);
+  ASSERT_CMP(video_mode.v_sync_pulse, <=, 1 << 6);
+  ASSERT_CMP(video_mode.v_back_porch, >=, 2);
+  const uint vsync_offset = pio_add_program(pio, &pio_vga_vsync_program);
+  pio_sm_config vsync_config = pio_vga_vsync_program_get_default_config(vsync_offset);
+  sm_config_set_sideset_pins(&vsync_config, rgbhv_gpio_start + kVSyncGpioShift);
+  sm_config_set_out_shift(&vsync_config, true, false, 32);
+  sm_config_set_clkdiv(&vsync_config, clkdiv);
+  pio_sm_init(pio, kVSyncStateMachine, vsync_offset, &vsync_config);
+  load(kVSyncStateMachine,
+      (video_mode.v_visible_area - 1)
+          | ((video_mode.v_front_porch - 2) << 10)
+          | ((video_mode.v_sync_pulse - 1) << 18)
+          | ((video_mode.v_back_porch - 2) << 24),
+      pio_isr);
+
+  // The programs generate active-high sync pulses.
+  if (video_mode.sync_polarity & kHSyncGpioByte) {
+    gpio_set_outover(rgbhv_gpio_start + kHSyncGpioShift, GPIO_OVERRIDE_INVERT);
+  }
+  if (video_mode.sync_polarity & kVSyncGpioByte) {
+    gpio_set_outover(rgbhv_gpio_start + kVSyncGpioShift, GPIO_OVERRIDE_INVERT);
+  }
+
+  pio_set_irq0_source_mask_enabled(pio,
+      (1u << (pis_interrupt0 + kPioIrqVblank)) | (1u << (pis_interrupt0 + kPioIrqFrameStart)),
+      /*enabled=*/true);
+}
+
 void start_vga() {
   constexpr uint8_t kRgbhvGpioStart =
     (Config::kBoard == Config::Board::rgb2vga) ? 8 :
     (Config::kBoard == Config::Board::murmulator) ? 6 :
     printf/*compile-time error*/("Unexpected BOARD\n");
-  const PIO kRgbGenPio = pio0_hw;
-  constexpr uint kStateMachine = 0;
 
-  // DMA buffer structure:
+  // DMA buffer structure (with -DTIMING=pio, only the visible part):
   // _____HHHHH_____XXXXX
   //      ^h_sync_pulse_front
   //      |<->|h_sync_pulse
 
   // Width of a DMA buffer, in bytes - that is, in RGB output pixels.
-  const int whole_line = video_mode.whole_line / video_mode.h_scale;
+  const int h_scale = pio_h_scale(video_mode);
+  const int line_size = dma_line_size(video_mode);
 
-  ASSERT(video_mode.h_visible_area % video_mode.h_scale == 0);
-  ASSERT(video_mode.h_front_porch % video_mode.h_scale == 0);
-  ASSERT(video_mode.h_sync_pulse % video_mode.h_scale == 0);
-  const int h_sync_pulse_front =
-      (video_mode.h_visible_area + video_mode.h_front_porch) / video_mode.h_scale;
-  const int h_sync_pulse = video_mode.h_sync_pulse / video_mode.h_scale;
+  ASSERT(video_mode.h_visible_area % h_scale == 0);
+  if (Config::kTiming == Config::Timing::dma) {  // Otherwise, timed at the native pixel clock.
+    ASSERT(video_mode.h_front_porch % h_scale == 0);
+    ASSERT(video_mode.h_sync_pulse % h_scale == 0);
+  }
+  ASSERT(line_size % 4 == 0);
 
-  vga_params = calc_vga_params(video_mode, vram);
+  vga_params = calc_vga_params(video_mode);
+  if (Config::kMode == Config::Mode::cvbs) {
+    cvbs_encoder.Init(video_mode, /*image_begin*/ vga_params.h_margin * video_mode.h_scale);
+  }
+  if (Config::kMode == Config::Mode::dvi) {
+    tmds_encoder.Init(video_mode, /*image_begin*/ vga_params.h_margin * video_mode.h_scale,
+        /*is_hsync_negative*/ (video_mode.sync_polarity & kHSyncGpioByte) != 0,
+        /*is_vsync_negative*/ (video_mode.sync_polarity & kVSyncGpioByte) != 0);
+  }
 
   set_sys_clock_khz(video_mode.sys_freq, /*required=*/true);
   sleep_ms(10);
@@ -428,72 +1610,190 @@ void start_vga() {
   for (int i = kRgbhvGpioStart; i < kRgbhvGpioStart + 8; ++i) {
     pio_gpio_init(kRgbGenPio, i);
     gpio_set_drive_strength(i, GPIO_DRIVE_STRENGTH_4MA);
-    gpio_set_slew_rate(i, GPIO_SLEW_RATE_SLOW);
+    // The TMDS bit clock needs sharp edges.
+    gpio_set_slew_rate(i,
+        (Config::kMode == Config::Mode::dvi) ? GPIO_SLEW_RATE_FAST : GPIO_SLEW_RATE_SLOW);
   }
 
-  dma_bufs[kDmaBufBlank] = (uint32_t*)malloc(whole_line);
-  memset(dma_bufs[kDmaBufBlank], (kNoSyncGpioByte ^ video_mode.sync_polarity), whole_line);
-  memset((uint8_t*)dma_bufs[kDmaBufBlank] + h_sync_pulse_front,
-      (kHSyncGpioByte ^ video_mode.sync_polarity), h_sync_pulse);
-
-  dma_bufs[kDmaBufVsync] = (uint32_t*)malloc(whole_line);
-  memset(dma_bufs[kDmaBufVsync], (kVSyncGpioByte ^ video_mode.sync_polarity), whole_line);
-  memset((uint8_t*)dma_bufs[kDmaBufVsync] + h_sync_pulse_front,
-      (kVHSyncGpioByte ^ video_mode.sync_polarity), h_sync_pulse);
-
-  dma_bufs[kDmaBufImageA] = (uint32_t*) malloc(whole_line);
-  memcpy(dma_bufs[kDmaBufImageA], dma_bufs[0], whole_line);
-
-  dma_bufs[kDmaBufImageB] = (uint32_t*) malloc(whole_line);
-  memcpy(dma_bufs[kDmaBufImageB], dma_bufs[0], whole_line);
-
-  // PIO initialization.
-  pio_sm_config state_machine_config = pio_get_default_sm_config();
+  if (Config::kTiming == Config::Timing::dma) {
+    prepare_v_blank_dma_bufs(video_mode, v_blank_dma_bufs);  // Including the blank line.
+  } else {
+    dma_bufs[kDmaBufBlank] = (uint32_t*)malloc(line_size);
+    memset(dma_bufs[kDmaBufBlank], (kNoSyncGpioByte ^ video_mode.sync_polarity), line_size);
+  }
 
-  // PIO program load.
-  const int pio_program_offset = pio_add_program(kRgbGenPio, &pio_vga_program);
-  sm_config_set_wrap(&state_machine_config,
-      pio_program_offset, pio_program_offset + (pio_vga_program.length - 1));
+  if (kIsLineRingScanout) {
+    prepare_vga_line_map(video_mode, vga_params);
+    vga_line_ring.Init(dma_bufs[kDmaBufBlank], line_size);
+    if (Config::kTiming == Config::Timing::pio) {
+      // The PIO starts with the vertical blanking, which ends the frame before the first one.
+      vga_scan.frame_seq = -vga_seq_count;
+    }
+    switch (Config::kMode) {
+      case Config::Mode::vga: {
+        multicore_launch_core1(vga_line_producer<kVideoModeVga640x480x60>);
+      } break;
+      case Config::Mode::dvi: {
+        multicore_launch_core1(vga_line_producer<kVideoModeVga640x480x60>);
+        // After the launch, which uses the FIFO itself.
+        irq_set_exclusive_handler(SIO_IRQ_PROC0, sio_handler_tmds_right_halves);
+        irq_set_priority(SIO_IRQ_PROC0, PICO_LOWEST_IRQ_PRIORITY);
+        irq_set_enabled(SIO_IRQ_PROC0, /*enabled=*/true);
+      } break;
+      case Config::Mode::agat7: {
+        multicore_launch_core1(vga_line_producer<kVideoModeAgat7>);
+      } break;
+      case Config::Mode::cvbs: {
+        multicore_launch_core1(vga_line_producer<kVideoModeCvbs>);
+      } break;
+      case Config::Mode::pal: break;  // Never: scanned out by the frame chain.
+    }
+  }
+  if (kIsVramScanout) {
+    ASSERT_CMP(vga_params.h_visible_area, % 8 ==, 0);  // Whole 32-bit words per Vram line.
+    prepare_vga_line_map(video_mode, vga_params);
+    prepare_vram_frame_dma_bufs();
+  }
+  if (kIsGpioFramebuffer) {
+    ASSERT_CMP(gpio_framebuffer->width_px() * h_scale, ==, video_mode.h_visible_area);
+    prepare_gpio_frame_dma_bufs();
+  }
 
-  sm_config_set_out_pins(&state_machine_config, kRgbhvGpioStart, 8);
   pio_sm_set_consecutive_pindirs(kRgbGenPio, kStateMachine, kRgbhvGpioStart, 8, true);
-
-  sm_config_set_out_shift(&state_machine_config, true, true, 32);
-  sm_config_set_fifo_join(&state_machine_config, PIO_FIFO_JOIN_TX);
-
-  // TODO: Investigate the formula.
-  sm_config_set_clkdiv(&state_machine_config,
-      ((float)clock_get_hz(clk_sys) * video_mode.h_scale) / video_mode.pixel_freq);
-
-  pio_sm_init(kRgbGenPio, kStateMachine, pio_program_offset, &state_machine_config);
-  pio_sm_set_enabled(kRgbGenPio, kStateMachine, /*enabled=*/true);
+  if (Config::kTiming == Config::Timing::pio) {
+    init_pio_timing(kRgbGenPio, kStateMachine, kRgbhvGpioStart, h_scale);  // Enabled below.
+  } else if (Config::kMode == Config::Mode::dvi) {
+    // The clock lane pair is driven by the side-set, and the data lane pairs follow it.
+    const uint tmds_offset = pio_add_program(kRgbGenPio, &pio_tmds_program);
+    pio_sm_config tmds_config = pio_tmds_program_get_default_config(tmds_offset);
+    sm_config_set_sideset_pins(&tmds_config, kRgbhvGpioStart);
+    sm_config_set_out_pins(&tmds_config, kRgbhvGpioStart + 2, 6);
+    sm_config_set_out_shift(&tmds_config, true, true, 30);
+    sm_config_set_fifo_join(&tmds_config, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv(&tmds_config, 1);  // The bit clock is the system clock.
+    pio_sm_init(kRgbGenPio, kStateMachine, tmds_offset, &tmds_config);
+    pio_sm_set_enabled(kRgbGenPio, kStateMachine, /*enabled=*/true);
+  } else {
+    // PIO initialization.
+    pio_sm_config state_machine_config = pio_get_default_sm_config();
+
+    // PIO program load.
+    const int pio_program_offset = pio_add_program(kRgbGenPio, &pio_vga_program);
+    sm_config_set_wrap(&state_machine_config,
+        pio_program_offset, pio_program_offset + (pio_vga_program.length - 1));
+
+    sm_config_set_out_pins(&state_machine_config, kRgbhvGpioStart, 8);
+
+    sm_config_set_out_shift(&state_machine_config, true, true, 32);
+    sm_config_set_fifo_join(&state_machine_config, PIO_FIFO_JOIN_TX);
+
+    // TODO: Investigate the formula.
+    sm_config_set_clkdiv(&state_machine_config,
+        ((float)clock_get_hz(clk_sys) * h_scale) / video_mode.pixel_freq);
+
+    pio_sm_init(kRgbGenPio, kStateMachine, pio_program_offset, &state_machine_config);
+    pio_sm_set_enabled(kRgbGenPio, kStateMachine, /*enabled=*/true);
+  }
 
   // DMA initialization.
   dma_ch0 = dma_claim_unused_channel(true);
   dma_ch1 = dma_claim_unused_channel(true);
 
+  const bool is_frame_chain = !kIsDirectScanout
+      && (Config::kMode == Config::Mode::agat7 || Config::kMode == Config::Mode::pal)
+      && Config::kAgat7Scanout == Config::Agat7Scanout::chain;
+  if (is_frame_chain) {
+    prepare_agat7_frame_dma_bufs();
+  }
+
   // DMA channel 0 - data.
   dma_channel_config ch0_config = dma_channel_get_default_config(dma_ch0);
   channel_config_set_transfer_data_size(&ch0_config, DMA_SIZE_32);
   channel_config_set_read_increment(&ch0_config, true);
   channel_config_set_write_increment(&ch0_config, false);
   channel_config_set_dreq(&ch0_config, DREQ_PIO0_TX0 + kStateMachine);
+  channel_config_set_high_priority(&ch0_config, true);  // Over VramDmaFill.
   // Set the DMA channel 1 to start when the DMA channel 0 completes.
   channel_config_set_chain_to(&ch0_config, dma_ch1);
+  // In the frame chain, ch0 raises an IRQ only on the null trigger at the end of the frame. With
+  // -DTIMING=pio, the frame end IRQs come from the PIO.
+  channel_config_set_irq_quiet(
+      &ch0_config, is_frame_chain || Config::kTiming == Config::Timing::pio);
   dma_channel_configure(
       dma_ch0,
       &ch0_config,
       /*write_addr=*/&kRgbGenPio->txf[kStateMachine],
       /*read_addr=*/dma_bufs[kDmaBufBlank],  // DMA will read data from the DMA buf.
-      /*encoded_transfer_count=*/whole_line / 4,
+      /*encoded_transfer_count=*/kIsVramScanout ? vga_params.h_visible_area / 8 : line_size / 4,
       /*trigger=*/false  // Don't start yet.
   );
 
   // DMA channel 1 - control.
   dma_channel_config ch1_config = dma_channel_get_default_config(dma_ch1);
   channel_config_set_transfer_data_size(&ch1_config, DMA_SIZE_32);
-  channel_config_set_read_increment(&ch1_config, false);
+  channel_config_set_high_priority(&ch1_config, true);
   channel_config_set_write_increment(&ch1_config, false);
+  if (Config::kTiming == Config::Timing::pio) {
+    // Writing to the trigger alias starts channel 0, which chains back to channel 1 when the line
+    // is done. The frame chain and the Vram scanout walk their tables by themselves; otherwise,
+    // the DMA IRQ handler sets the entry for the next line. After the last image line, the null
+    // entry stops the DMA until the PIO IRQ handler restarts it at the end of the vertical
+    // blanking.
+    const bool is_table_walk = is_frame_chain || kIsDirectScanout;
+    channel_config_set_read_increment(&ch1_config, is_table_walk);
+    channel_config_set_chain_to(&ch1_config, dma_ch1);  // Chaining to itself means no chaining.
+    dma_channel_configure(
+        dma_ch1,
+        &ch1_config,
+        /*write_addr=*/&dma_hw->ch[dma_ch0].al3_read_addr_trig,
+        /*read_addr=*/&null_dma_buf,
+        /*encoded_transfer_count=*/1,
+        /*trigger=*/false  // Don't start yet.
+    );
+
+    if (!is_table_walk) {
+      // Set IRQ0 to trigger when the DMA channel 1 completes.
+      dma_channel_set_irq0_enabled(dma_ch1, /*enabled=*/true);
+      irq_set_exclusive_handler(DMA_IRQ_0, line_dma_handler());
+      irq_set_enabled(DMA_IRQ_0, /*enabled=*/true);
+    }
+    irq_set_exclusive_handler(PIO0_IRQ_0,
+        kIsDirectScanout ? pio_handler_vram :
+        kIsLineRingScanout ? pio_handler_vga :
+        pio_handler_agat7);
+    irq_set_enabled(PIO0_IRQ_0, /*enabled=*/true);
+
+    // The state machines start with the vertical blanking, at the end of which the PIO IRQ
+    // handler starts the DMA.
+    pio_enable_sm_mask_in_sync(kRgbGenPio,
+        (1u << kStateMachine) | (1u << kHSyncStateMachine) | (1u << kVSyncStateMachine));
+    return;
+  }
+
+  if (is_frame_chain) {
+    // Walk the frame table, one entry per line; writing to the trigger alias starts channel 0,
+    // which chains back to channel 1 when the line is done.
+    channel_config_set_read_increment(&ch1_config, true);
+    channel_config_set_chain_to(&ch1_config, dma_ch1);  // Chaining to itself means no chaining.
+    dma_channel_configure(
+        dma_ch1,
+        &ch1_config,
+        /*write_addr=*/&dma_hw->ch[dma_ch0].al3_read_addr_trig,
+        /*read_addr=*/&agat7_frame_dma_bufs[0],
+        /*encoded_transfer_count=*/1,
+        /*trigger=*/false  // Don't start yet.
+    );
+
+    // Set IRQ0 to trigger on the null trigger of the DMA channel 0.
+    dma_channel_set_irq0_enabled(dma_ch0, /*enabled=*/true);
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_handler_agat7_frame);
+    irq_set_enabled(DMA_IRQ_0, /*enabled=*/true);
+
+    dma_start_channel_mask((1u << dma_ch1));  // Start DMA channel 1, it will start channel 0.
+    return;
+  }
+
+  channel_config_set_read_increment(&ch1_config, false);
   // Set the DMA channel 0 to start when the DMA channel 1 completes.
   channel_config_set_chain_to(&ch1_config, dma_ch0);
   dma_channel_configure(
@@ -509,19 +1809,213 @@ void start_vga() {
   dma_channel_set_irq0_enabled(dma_ch1, /*enabled=*/true);
 
   // Assign an IRQ0 handler - a callback that will be called when the DMA channel 1 completes.
-  switch (Config::kMode) {
-    case Config::Mode::vga: {
-      irq_set_exclusive_handler(DMA_IRQ_0, dma_handler_vga);
-    } break;
-    case Config::Mode::agat7: {
-      irq_set_exclusive_handler(DMA_IRQ_0, dma_handler_agat7);
-    } break;
-  }
+  irq_set_exclusive_handler(DMA_IRQ_0, line_dma_handler());
   irq_set_enabled(DMA_IRQ_0, /*enabled=*/true);
 
   dma_start_channel_mask((1u << dma_ch0));  // Start DMA channel 1.
 }
 
+//-------------------------------------------------------------------------------------------------
+// Second output (-DSECOND_OUTPUT=agat7)
+
+// R, G and B of 2 bits each, as on the main output, then the composite sync; the V-sync bit of the
+// GPIO bytes falls outside of the pin group.
+constexpr uint kSecondRgbsGpioStart = 16;
+constexpr uint kSecondRgbsGpioCount = kRgbGpioCount + 1;
+static_assert(kHSyncGpioShift == kRgbGpioCount);
+
+const PIO kSecondPio = pio1_hw;
+constexpr uint kSecondStateMachine = 0;
+static int second_dma_ch0;
+static int second_dma_ch1;
+
+static int second_refresh_irq;  // A user IRQ, see dma_handler_second_frame().
+
+static debug::CycleStats second_refresh_cycles;  // Filled if -DPROFILE=on.
+
+// Like dma_handler_agat7_frame(), but the Vram flips are left to the main output. Restarts the
+// frame chain only, at the priority of the main output IRQs, so that the next frame is not
+// delayed by whatever runs at the lowest priority; the re-rendering is left to
+// irq_handler_second_refresh(). The IRQ is shared with VramDmaFill.
+void __not_in_flash_func(dma_handler_second_frame)() {
+  if ((dma_hw->ints1 & (1u << second_dma_ch0)) == 0) {
+    return;
+  }
+  dma_hw->ints1 = 1u << second_dma_ch0;
+  dma_channel_set_read_addr(second_dma_ch1, &agat7_frame_dma_bufs[0], /*trigger=*/true);
+  irq_set_pending(second_refresh_irq);
+}
+
+// Re-renders the dirty lines after each frame of the second output. Has the lowest priority, so
+// that it is preempted by the line IRQs of the main output.
+void __not_in_flash_func(irq_handler_second_refresh)() {
+  debug::ScopedCycleMeter cycle_meter(second_refresh_cycles);
+  refresh_dirty_agat7_dma_bufs(kAgat7RefreshBudgetUs);
+}
+
+// Starts the Agat-7 frame chain on the second pin group, with the PIO and the DMA channels of its
+// own. Must be called after start_vga(), which sets the system clock.
+void start_second_output() {
+  second_palette.Init(kVideoModeAgat7);
+  prepare_v_blank_dma_bufs(kVideoModeAgat7, second_v_blank_dma_bufs);
+  prepare_agat7_dma_bufs();
+  prepare_agat7_frame_dma_bufs();
+
+  for (uint i = kSecondRgbsGpioStart; i < kSecondRgbsGpioStart + kSecondRgbsGpioCount; ++i) {
+    pio_gpio_init(kSecondPio, i);
+    gpio_set_drive_strength(i, GPIO_DRIVE_STRENGTH_4MA);
+    gpio_set_slew_rate(i, GPIO_SLEW_RATE_SLOW);
+  }
+  pio_sm_set_consecutive_pindirs(kSecondPio, kSecondStateMachine,
+      kSecondRgbsGpioStart, kSecondRgbsGpioCount, true);
+
+  const uint program_offset = pio_add_program(kSecondPio, &pio_vga_program);
+  pio_sm_config state_machine_config = pio_get_default_sm_config();
+  sm_config_set_wrap(&state_machine_config,
+      program_offset, program_offset + (pio_vga_program.length - 1));
+  sm_config_set_out_pins(&state_machine_config, kSecondRgbsGpioStart, kSecondRgbsGpioCount);
+  sm_config_set_out_shift(&state_machine_config, true, true, 32);
+  sm_config_set_fifo_join(&state_machine_config, PIO_FIFO_JOIN_TX);
+  sm_config_set_clkdiv(&state_machine_config,
+      ((float)clock_get_hz(clk_sys) * kVideoModeAgat7.h_scale) / kVideoModeAgat7.pixel_freq);
+  pio_sm_init(kSecondPio, kSecondStateMachine, program_offset, &state_machine_config);
+  pio_sm_set_enabled(kSecondPio, kSecondStateMachine, /*enabled=*/true);
+
+  second_dma_ch0 = dma_claim_unused_channel(true);
+  second_dma_ch1 = dma_claim_unused_channel(true);
+
+  // Data: raises an IRQ only on the null trigger at the end of the frame.
+  dma_channel_config ch0_config = dma_channel_get_default_config(second_dma_ch0);
+  channel_config_set_transfer_data_size(&ch0_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&ch0_config, true);
+  channel_config_set_write_increment(&ch0_config, false);
+  channel_config_set_dreq(&ch0_config, pio_get_dreq(kSecondPio, kSecondStateMachine, true));
+  channel_config_set_high_priority(&ch0_config, true);  // Over VramDmaFill.
+  channel_config_set_chain_to(&ch0_config, second_dma_ch1);
+  channel_config_set_irq_quiet(&ch0_config, true);
+  dma_channel_configure(
+      second_dma_ch0,
+      &ch0_config,
+      /*write_addr=*/&kSecondPio->txf[kSecondStateMachine],
+      /*read_addr=*/agat7_frame_dma_bufs[0],
+      /*encoded_transfer_count=*/dma_line_size(kVideoModeAgat7) / 4,
+      /*trigger=*/false  // Don't start yet.
+  );
+
+  // Control: walks the frame table, see start_vga().
+  dma_channel_config ch1_config = dma_channel_get_default_config(second_dma_ch1);
+  channel_config_set_transfer_data_size(&ch1_config, DMA_SIZE_32);
+  channel_config_set_high_priority(&ch1_config, true);
+  channel_config_set_read_increment(&ch1_config, true);
+  channel_config_set_write_increment(&ch1_config, false);
+  channel_config_set_chain_to(&ch1_config, second_dma_ch1);  // Itself means no chaining.
+  dma_channel_configure(
+      second_dma_ch1,
+      &ch1_config,
+      /*write_addr=*/&dma_hw->ch[second_dma_ch0].al3_read_addr_trig,
+      /*read_addr=*/&agat7_frame_dma_bufs[0],
+      /*encoded_transfer_count=*/1,
+      /*trigger=*/false  // Don't start yet.
+  );
+
+  second_refresh_irq = user_irq_claim_unused(true);
+  irq_set_exclusive_handler(second_refresh_irq, irq_handler_second_refresh);
+  irq_set_priority(second_refresh_irq, PICO_LOWEST_IRQ_PRIORITY);
+  irq_set_enabled(second_refresh_irq, /*enabled=*/true);
+
+  dma_channel_set_irq1_enabled(second_dma_ch0, /*enabled=*/true);
+  irq_add_shared_handler(
+      DMA_IRQ_1, dma_handler_second_frame, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  // Over the lowest priority set by VramDmaFill::Init(). Its handler then runs at the scanout
+  // priority too; it is as short, up to a word write per 32 lines and the `on_done` callback,
+  // which must be short as well. irq_handler_second_refresh() stays below both: its dirty mark
+  // clears are atomic against the marks set here and in Vram::OnVblank().
+  irq_set_priority(DMA_IRQ_1, PICO_DEFAULT_IRQ_PRIORITY);
+  irq_set_enabled(DMA_IRQ_1, /*enabled=*/true);
+
+  dma_start_channel_mask((1u << second_dma_ch1));
+}
+
+// Prints the DMA bus load of the output in the mode: the data channel reads the line buffer, and
+// the control channel a pointer per line; the DMA can do a transfer per system clock cycle. Also
+// prints the line period, which is the budget of the per-line work of the CPU. The load is
+// computed from the mode, not measured; a DMA which does not keep up shows as a TX FIFO underrun,
+// see take_tx_fifo_underrun().
+void print_dma_load(const char* output_name, const VideoMode& video_mode) {
+  const uint32_t sys_hz = clock_get_hz(clk_sys);
+  const uint32_t line_hz = (uint32_t) (video_mode.pixel_freq / video_mode.whole_line);
+  const uint32_t words_per_second = line_hz * (dma_line_size(video_mode) / 4 + 1);
+  printf("%s output: DMA %lu words/s (%lu.%02lu%% of the bus, computed), line period %lu cycles\n",
+      output_name, (unsigned long) words_per_second,
+      (unsigned long) (words_per_second * 100ull / sys_hz),
+      (unsigned long) (words_per_second * 10'000ull / sys_hz % 100),
+      (unsigned long) (sys_hz / line_hz));
+}
+
+// Returns whether the state machine has stalled on its empty TX FIFO since the previous call,
+// i.e. the DMA has not kept up; the FIFO never runs empty by design with -DTIMING=dma.
+bool take_tx_fifo_underrun(PIO pio, uint state_machine) {
+  const uint32_t stall_mask = 1u << (PIO_FDEBUG_TXSTALL_LSB + state_machine);
+  const bool has_stalled = (pio->fdebug & stall_mask) != 0;
+  pio->fdebug = stall_mask;  // Write 1 to clear.
+  return has_stalled;
+}
+
+//-------------------------------------------------------------------------------------------------
+// GPIO framebuffer (-DFRAMEBUFFER=gpio)
+
+// Draws the 64-color test patterns into the GPIO framebuffer: all the colors as an 8x8 chart on
+// the top half, and the 4 levels of red, green, blue and gray as ramps on the bottom half.
+void draw_gpio_test_patterns(GpioFramebuffer& framebuffer) {
+  const auto to_gpio_byte = [](int r, int g, int b) -> uint8_t {
+    return (r << kRedGpioShift) | (g << kGreenGpioShift) | (b << kBlueGpioShift);
+  };
+  // Fills the cell of a grid of equal cells, whose edges are rounded to a pixel.
+  const auto fill_cell = [&framebuffer](int top, int height, int column, int column_count,
+      int row, int row_count, uint8_t gpio_byte) {
+    const int width = framebuffer.width_px();
+    const int x = width * column / column_count;
+    const int y = top + height * row / row_count;
+    framebuffer.FillRect(x, y, width * (column + 1) / column_count - x,
+        top + height * (row + 1) / row_count - y, gpio_byte);
+  };
+
+  constexpr int kLevelCount = 4;  // Per R, G and B.
+  const int chart_height = framebuffer.height() / 2;
+  for (int color = 0; color < kLevelCount * kLevelCount * kLevelCount; ++color) {
+    fill_cell(/*top*/ 0, chart_height, color % 8, 8, color / 8, 8,
+        to_gpio_byte(color % kLevelCount, color / kLevelCount % kLevelCount,
+            color / (kLevelCount * kLevelCount)));
+  }
+
+  constexpr int kRampCount = 4;  // Red, green, blue, gray.
+  for (int ramp = 0; ramp < kRampCount; ++ramp) {
+    for (int level = 0; level < kLevelCount; ++level) {
+      fill_cell(chart_height, framebuffer.height() - chart_height, level, kLevelCount,
+          ramp, kRampCount, to_gpio_byte(
+              (ramp == 0 || ramp == 3) ? level : 0,
+              (ramp == 1 || ramp == 3) ? level : 0,
+              (ramp == 2 || ramp == 3) ? level : 0));
+    }
+  }
+}
+
+// Prints the demo screen of the text mode for its column count: the title, all the characters,
+// and a line in each color; the last line is left for the uptime, printed by the main loop.
+void print_text_mode_screen(Agat7TextMode& text_mode) {
+  const int column_count = text_mode.column_count();
+  text_mode.Clear();
+  char title[32];
+  snprintf(title, sizeof(title), "AGAT-7 TEXT MODE, %d COLUMNS", column_count);
+  text_mode.PrintAt(0, 0, title, Vram::kBrightWhite);
+  for (int c = 32; c < 128; ++c) {  // With the Russian letters at 96..127.
+    text_mode.SetChar((c - 32) % column_count, 2 + (c - 32) / column_count, c, Vram::kGreen);
+  }
+  for (int color = Vram::kBlack + 1; color < Vram::kColorCount; ++color) {
+    text_mode.PrintAt(0, 6 + color, "COLOR", (Vram::Color) color);
+  }
+}
+
 //-------------------------------------------------------------------------------------------------
 
 int main() {
@@ -533,21 +2027,123 @@ int main() {
   printf("Started.\n");
 
   debug::SetBuiltInLed(false);  // Clear the assertion LED from the state before reset.
-  Agat7Picture agat7_picture(agat7_renderer);
-  agat7_picture.DrawPicture(kVideoModeAgat7);
+  if constexpr (Config::kLineSource == Config::LineSource::vram) {
+    vram = new Vram();
+  } else if constexpr (Config::kLineSource == Config::LineSource::pattern) {
+    line_patterns = new LinePatterns(Vram::kWidthPx, Vram::kLineCount);
+  } else {
+    agat7_text_mode = new Agat7TextMode();
+  }
+  if constexpr (Config::kLineSource == Config::LineSource::vram && !kIsGpioFramebuffer
+      && Vram::kBitsPerPixel == 4) {
+    static VramDmaFill vram_dma_fill;
+    vram_dma_fill.Init(*vram);
+    const uint32_t clear_start_us = time_us_32();
+    vram_dma_fill.StartClear(Vram::kBlack);
+    vram_dma_fill.WaitUntilDone();
+    printf("Vram cleared by DMA in %lu us.\n", (unsigned long) (time_us_32() - clear_start_us));
+
+    static Agat7Renderer agat7_renderer(*vram);
+    Agat7Picture agat7_picture(agat7_renderer);
+    const uint32_t draw_start_us = time_us_32();
+    agat7_picture.DrawPicture(kVideoModeAgat7);
+    printf("Agat-7 picture drawn in %lu us.\n", (unsigned long) (time_us_32() - draw_start_us));
+    if constexpr (Config::kProfile == Config::Profile::on) {
+      const uint32_t text_start_us = time_us_32();
+      agat7_renderer.RenderTextBuffer();  // Again, only to time it: draws the same pixels.
+      printf("Agat-7 text (%dx%d characters) rendered in %lu us.\n", Agat7Renderer::kTextWidth,
+          Agat7Renderer::kTextHeight, (unsigned long) (time_us_32() - text_start_us));
+    }
+  }
 
   switch (Config::kMode) {
-    case Config::Mode::vga: {
+    case Config::Mode::vga:
+    case Config::Mode::dvi: {
       video_mode = kVideoModeVga640x480x60;
     } break;
     case Config::Mode::agat7: {
       video_mode = kVideoModeAgat7;
     } break;
+    case Config::Mode::pal: {
+      video_mode = kVideoModePal625i;
+    } break;
+    case Config::Mode::cvbs: {
+      video_mode = kVideoModeCvbs;
+    } break;
   };
 
+  if constexpr (kIsGpioFramebuffer) {
+    gpio_framebuffer = new GpioFramebuffer(
+        video_mode.h_visible_area / video_mode.h_scale,
+        video_mode.v_visible_area / video_mode.v_scale);
+    draw_gpio_test_patterns(*gpio_framebuffer);
+  }
+
+  if constexpr (Config::kLineSource == Config::LineSource::text) {
+    print_text_mode_screen(*agat7_text_mode);
+  }
+
   palette.Init(video_mode);
-  prepare_agat7_dma_bufs();
+  doubled_palette.Init(palette);
+  if (!kIsLineRingScanout && !kIsDirectScanout) {
+    prepare_agat7_dma_bufs();
+  }
   start_vga();
+  print_dma_load("Main", video_mode);
+  if constexpr (kIsSecondOutput) {
+    start_second_output();
+    print_dma_load("Second", kVideoModeAgat7);
+  }
 
-  for (;;);
+  if constexpr (Config::kProfile == Config::Profile::on) {
+    debug::CycleStats::StartSysTick();  // DMA IRQs are handled on this core.
+  }
+  take_tx_fifo_underrun(kRgbGenPio, kStateMachine);  // Clear the stalls of the start.
+  if constexpr (kIsSecondOutput) {
+    take_tx_fifo_underrun(kSecondPio, kSecondStateMachine);
+  }
+  for (int second = 1;; ++second) {
+    if constexpr (kIsLineRingScanout) {
+      serve_scanout_geometry_commands(time_us_32() + 1'000'000);
+    } else {
+      sleep_ms(1000);
+    }
+    if constexpr (Config::kLineSource == Config::LineSource::pattern) {
+      constexpr int kSecondsPerPattern = 3;
+      constexpr int kPatternCount = (int) LinePatterns::Pattern::count;
+      if (second % kSecondsPerPattern == 0) {  // Show the patterns one after another.
+        line_patterns->Select(
+            (LinePatterns::Pattern) ((second / kSecondsPerPattern) % kPatternCount));
+      }
+    }
+    if constexpr (Config::kLineSource == Config::LineSource::text) {
+      constexpr int kSecondsPerColumnCount = 5;
+      if (second % kSecondsPerColumnCount == 0) {  // Alternate 32 and 64 columns.
+        agat7_text_mode->SetColumnCount(
+            (second / kSecondsPerColumnCount % 2 != 0) ? Agat7TextMode::kMaxColumnCount : 32);
+        print_text_mode_screen(*agat7_text_mode);
+      }
+      // A byte write per changed character; the scanout shows it on the next frame.
+      char uptime[32];
+      snprintf(uptime, sizeof(uptime), "UPTIME %d S", second);
+      agat7_text_mode->PrintAt(0, Agat7TextMode::kRowCount - 1, uptime, Vram::kYellow);
+    }
+    if constexpr (Config::kProfile == Config::Profile::on) {
+      dma_handler_cycles.PrintAndReset("DMA IRQ handler");
+      if (kIsLineRingScanout) {
+        vga_line_conversion_cycles.PrintAndReset("Line conversion (core 1)");
+        printf("Late lines: %lu\n", (unsigned long) vga_late_line_count);
+      }
+      if (Config::kTiming == Config::Timing::dma
+          && take_tx_fifo_underrun(kRgbGenPio, kStateMachine)) {
+        printf("Main output: TX FIFO underrun\n");
+      }
+      if constexpr (kIsSecondOutput) {
+        second_refresh_cycles.PrintAndReset("Second output refresh");
+        if (take_tx_fifo_underrun(kSecondPio, kSecondStateMachine)) {
+          printf("Second output: TX FIFO underrun\n");
+        }
+      }
+    }
+  }
 }
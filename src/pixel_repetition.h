@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <pico.h>
+#include <hardware/pio_instructions.h>
+
+#include "debug.h"
+
+// With -DTIMING=pio: adds the delay to the two instructions of the pixel loop of pio_vga_pixels
+// (or pio_vga_nibbles) at `pixel_offset` of the program instructions, so that each pixel takes
+// 2 * h_scale cycles instead of 2.
+inline void add_pixel_repetition(uint16_t* instructions, uint pixel_offset, int h_scale) {
+  ASSERT_CMP(h_scale, >=, 1);
+  ASSERT_CMP(h_scale, <=, 32);  // The delay field is 5 bits wide.
+  instructions[pixel_offset] |= pio_encode_delay(h_scale - 1);
+  instructions[pixel_offset + 1] |= pio_encode_delay(h_scale - 1);
+}
@@ -0,0 +1,40 @@
+#include "scanout_geometry.h"
+
+#include "debug.h"
+
+namespace {
+
+// Reverses the order of the 8 pixels of the word: the bytes, then the nibbles in each byte.
+__force_inline uint32_t MirrorPixels(uint32_t word) {
+  word = __builtin_bswap32(word);
+  return ((word >> 4) & 0x0F0F'0F0F) | ((word & 0x0F0F'0F0F) << 4);
+}
+
+}  // namespace
+
+void __not_in_flash_func(ScanoutGeometry::TransformLine)(
+    uint32_t* dest, Span<const uint8_t> line_bytes) const {
+  ASSERT_CMP(line_bytes.size(), % 4 ==, 0);
+  ASSERT_CMP((uintptr_t) line_bytes.data(), % 4 ==, 0u);
+  const uint32_t* const words = (const uint32_t*) line_bytes.data();
+  const int word_count = line_bytes.size() / 4;
+
+  // The word i of the mirrored line, wrapping around once.
+  const auto mirrored_word = [this, words, word_count](int i) {
+    if (i >= word_count) {
+      i -= word_count;
+    }
+    return is_h_mirrored ? MirrorPixels(words[word_count - 1 - i]) : words[i];
+  };
+
+  // The even pixel is the low nibble, so moving the pixels left shifts the words right.
+  const int offset = x_offset % (word_count * 8);
+  const int shift = offset % 8 * 4;
+  int word_index = offset / 8;
+  uint32_t word = mirrored_word(word_index);
+  for (int i = 0; i < word_count; ++i) {
+    const uint32_t next_word = mirrored_word(++word_index);
+    dest[i] = (shift == 0) ? word : (word >> shift) | (next_word << (32 - shift));
+    word = next_word;
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <pico.h>
+
+#include "span.h"
+
+// Mirror, flip and scroll of the picture, applied by the line ring scanout to the lines as it
+// converts them, so that changing them costs no redraw; see set_scanout_geometry() in main.cpp.
+// The scanout latches the geometry at the start of each frame.
+//
+// Fits a 32-bit word, so that it can be handed over between the cores with an atomic store.
+struct ScanoutGeometry {
+  // The picture moves left by x_offset pixels and up by y_offset lines, wrapping around; the
+  // offsets apply to the mirrored and flipped picture.
+  uint32_t x_offset: 11 = 0;
+  uint32_t y_offset: 11 = 0;
+  uint32_t is_h_mirrored: 1 = 0;
+  uint32_t is_v_flipped: 1 = 0;
+
+  bool operator==(const ScanoutGeometry&) const = default;
+
+  bool IsHorzIdentity() const { return x_offset == 0 && !is_h_mirrored; }
+
+  // The source line shown as the line y of a picture of `height` lines.
+  __force_inline int SourceLine(int y, int height) const {
+    const int scrolled_y = (y + (int) y_offset) % height;
+    return is_v_flipped ? height - 1 - scrolled_y : scrolled_y;
+  }
+
+  // Puts the 4-bit pixels of the line, mirrored and scrolled, into `dest`, in a single pass of
+  // 32-bit word operations; the line is whole aligned words.
+  void TransformLine(uint32_t* dest, Span<const uint8_t> line_bytes) const;
+};
+static_assert(sizeof(ScanoutGeometry) == 4);
@@ -0,0 +1,181 @@
+#include "tmds_encoder.h"
+
+#include <stdlib.h>
+
+#include "debug.h"
+
+namespace {
+
+// The control symbols of the blanking, by the control bits C1 C0 (V-sync and H-sync on lane 0).
+constexpr uint16_t kControlSymbols[4]{0b1101010100, 0b0010101011, 0b0101010100, 0b1010101011};
+
+int CountOnes(uint32_t value) {
+  int count = 0;
+  for (; value != 0; value &= value - 1) {
+    ++count;
+  }
+  return count;
+}
+
+// The balanced level nearest to the given one, see TmdsEncoder.
+uint8_t ToBalancedLevel(int level) {
+  for (int distance = 0; distance < 256; ++distance) {
+    for (const int candidate: {level - distance, level + distance}) {
+      if (candidate < 0 || candidate > 255) {
+        continue;
+      }
+      int disparity = 0;
+      const uint16_t symbol = TmdsEncoder::EncodeSymbol((uint8_t) candidate, disparity);
+      if (disparity == 0 && CountOnes(symbol) == TmdsEncoder::kSymbolBits / 2) {
+        return (uint8_t) candidate;
+      }
+    }
+  }
+  ASSERT(false, "No balanced TMDS symbol near %d", level);
+  return 0;
+}
+
+}  // namespace
+
+uint16_t TmdsEncoder::EncodeSymbol(uint8_t value, int& disparity) {
+  // Transition minimization: XOR or XNOR of each bit with the previous result bit, the one which
+  // makes fewer transitions; bit 8 tells which.
+  const int value_ones = CountOnes(value);
+  const bool is_xnor = value_ones > 4 || (value_ones == 4 && (value & 1) == 0);
+  uint16_t q_m = value & 1;
+  for (int i = 1; i < 8; ++i) {
+    const int bit = ((q_m >> (i - 1)) ^ (value >> i) ^ (is_xnor ? 1 : 0)) & 1;
+    q_m |= bit << i;
+  }
+  if (!is_xnor) {
+    q_m |= 1 << 8;
+  }
+
+  // DC balancing: invert the 8 bits if this lowers the running disparity; bit 9 tells so.
+  const int ones = CountOnes(q_m & 0xFF);
+  const int balance = ones - (8 - ones);
+  const bool is_q_m8 = !is_xnor;
+  if (disparity == 0 || balance == 0) {
+    if (is_q_m8) {
+      disparity += balance;
+      return q_m;
+    }
+    disparity -= balance;
+    return (1 << 9) | (q_m ^ 0xFF);
+  }
+  if ((disparity > 0 && balance > 0) || (disparity < 0 && balance < 0)) {
+    disparity += (is_q_m8 ? 2 : 0) - balance;
+    return (1 << 9) | (q_m ^ 0xFF);
+  }
+  disparity += balance - (is_q_m8 ? 0 : 2);
+  return q_m;
+}
+
+uint8_t TmdsEncoder::DecodeSymbol(uint16_t symbol) {
+  const uint8_t q_m = (symbol & (1 << 9)) ? ~symbol : symbol;
+  const bool is_xnor = (symbol & (1 << 8)) == 0;
+  uint8_t value = q_m & 1;
+  for (int i = 1; i < 8; ++i) {
+    const int bit = ((q_m >> i) ^ (q_m >> (i - 1)) ^ (is_xnor ? 1 : 0)) & 1;
+    value |= bit << i;
+  }
+  return value;
+}
+
+void TmdsEncoder::ToWords(const uint16_t (&symbols)[3], uint32_t (&words)[kWordsPerPixel]) {
+  // The symbols are sent from the LSB; each data lane pair is the negative pin, then the positive.
+  static_assert(kWordsPerPixel * 5 == kSymbolBits);
+  for (int word = 0; word < kWordsPerPixel; ++word) {
+    words[word] = 0;
+    for (int i = 0; i < 5; ++i) {
+      const int bit_time = word * 5 + i;
+      for (int lane = 0; lane < 3; ++lane) {
+        const uint32_t bit = (symbols[lane] >> bit_time) & 1;
+        words[word] |= ((bit ^ 1) | (bit << 1)) << (i * 6 + lane * 2);
+      }
+    }
+  }
+}
+
+void TmdsEncoder::Init(const VideoMode& video_mode, int image_begin, bool is_hsync_negative,
+    bool is_vsync_negative) {
+  ASSERT_CMP(video_mode.h_scale, ==, kPixelRepetition);
+  image_begin_ = image_begin;
+  h_visible_area_ = video_mode.h_visible_area;
+  h_sync_pulse_front_ = video_mode.h_visible_area + video_mode.h_front_porch;
+  h_sync_pulse_end_ = h_sync_pulse_front_ + video_mode.h_sync_pulse;
+  whole_line_ = video_mode.whole_line;
+  is_hsync_negative_ = is_hsync_negative;
+  is_vsync_negative_ = is_vsync_negative;
+
+  // Like the RGB outputs: 2/3 of the full level for a normal color, the full level for a bright
+  // one.
+  const uint8_t normal_level = ToBalancedLevel(255 * 2 / 3);
+  const uint8_t bright_level = ToBalancedLevel(255);
+  const uint8_t black_level = ToBalancedLevel(0);
+  for (int color = 0; color < Vram::kColorCount; ++color) {
+    const uint8_t value = (color & Vram::kBright) ? bright_level : normal_level;
+    const uint8_t levels[3]{
+        (color & Vram::kBlue) ? value : black_level,
+        (color & Vram::kGreen) ? value : black_level,
+        (color & Vram::kRed) ? value : black_level,
+    };
+    uint16_t symbols[3];
+    for (int lane = 0; lane < 3; ++lane) {
+      int disparity = 0;
+      symbols[lane] = EncodeSymbol(levels[lane], disparity);
+      ASSERT_CMP(disparity, ==, 0);
+      ASSERT_CMP(DecodeSymbol(symbols[lane]), ==, levels[lane]);
+    }
+    ToWords(symbols, color_words_[color]);
+  }
+  for (int vsync = 0; vsync < 2; ++vsync) {
+    for (int hsync = 0; hsync < 2; ++hsync) {
+      const uint16_t symbols[3]{
+          kControlSymbols[(vsync << 1) | hsync], kControlSymbols[0], kControlSymbols[0]};
+      ToWords(symbols, control_words_[vsync][hsync]);
+    }
+  }
+}
+
+void TmdsEncoder::FillPixels(
+    uint32_t* line, int begin, int end, const uint32_t (&words)[kWordsPerPixel]) const {
+  for (int x = begin; x < end; ++x) {
+    line[x * kWordsPerPixel] = words[0];
+    line[x * kWordsPerPixel + 1] = words[1];
+  }
+}
+
+void TmdsEncoder::EncodeBlankLine(uint32_t* line, bool is_vsync, bool is_video_period) const {
+  const int vsync_level = is_vsync != is_vsync_negative_;
+  const int hsync_idle_level = is_hsync_negative_;
+  const auto& blank_words = control_words_[vsync_level][hsync_idle_level];
+  FillPixels(line, 0, h_visible_area_,
+      is_video_period ? color_words_[Vram::kBlack] : blank_words);
+  FillPixels(line, h_visible_area_, h_sync_pulse_front_, blank_words);
+  FillPixels(line, h_sync_pulse_front_, h_sync_pulse_end_,
+      control_words_[vsync_level][!hsync_idle_level]);
+  FillPixels(line, h_sync_pulse_end_, whole_line_, blank_words);
+}
+
+void __not_in_flash_func(TmdsEncoder::EncodeLine)(
+    uint32_t* line, Span<const uint8_t> vram_bytes, int first_vram_byte) const {
+  static_assert(kWordsPerPixel == 2 && kPixelRepetition == 2);
+  constexpr int kWordsPerVramByte = 2 * kPixelRepetition * kWordsPerPixel;
+  uint32_t* word_ptr = line + image_begin_ * kWordsPerPixel + first_vram_byte * kWordsPerVramByte;
+  const uint8_t* const vram_byte_ptr = vram_bytes.data();
+  for (int i = 0; i < vram_bytes.size(); ++i) {
+    const uint8_t byte = vram_byte_ptr[i];
+    const uint32_t* const lo_words = color_words_[byte & 0x0F];  // The even pixel.
+    const uint32_t* const hi_words = color_words_[byte >> 4];
+    word_ptr[0] = lo_words[0];
+    word_ptr[1] = lo_words[1];
+    word_ptr[2] = lo_words[0];
+    word_ptr[3] = lo_words[1];
+    word_ptr[4] = hi_words[0];
+    word_ptr[5] = hi_words[1];
+    word_ptr[6] = hi_words[0];
+    word_ptr[7] = hi_words[1];
+    word_ptr += kWordsPerVramByte;
+  }
+}
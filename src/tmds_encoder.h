@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <pico.h>
+
+#include "span.h"
+#include "video_mode.h"
+#include "vram.h"
+
+// DVI (TMDS) output of a 640x480 frame on the 8 output pins, wired as 4 differential pairs: the
+// clock lane, then the data lanes 0 (blue, carrying H-sync and V-sync in the blanking), 1 (green)
+// and 2 (red), each pair having the negative pin first; see Config::Mode::dvi.
+//
+// pio_tmds serializes one bit time per cycle at the bit clock (10x the pixel clock): each 32-bit
+// word of a DMA line buffer holds 5 bit times of the 3 data lanes, 6 bits each, and the side-set
+// drives the clock lane. So a pixel is 2 words.
+//
+// Each Vram color is shown with the nearest levels whose TMDS symbols have as many ones as zeros,
+// so the running disparity stays 0, and a pixel has the same symbols whatever precedes it. Then
+// the words of each color are precomputed, and a line is encoded with a table lookup per pixel.
+class TmdsEncoder {
+ public:
+  static constexpr int kSymbolBits = 10;
+  static constexpr int kWordsPerPixel = 2;
+  static constexpr int kBytesPerPixel = kWordsPerPixel * 4;
+  static constexpr int kPixelRepetition = 2;  // Screen pixels per Vram pixel.
+
+  // `video_mode` gives the line layout and the sync polarity, and `image_begin` is the screen
+  // pixel of the first Vram pixel.
+  void Init(const VideoMode& video_mode, int image_begin, bool is_hsync_negative,
+      bool is_vsync_negative);
+
+  // Puts a line without Vram pixels into the buffer: black pixels in the visible area if
+  // `is_video_period` (the black bars), or the control symbols of the vertical blanking.
+  void EncodeBlankLine(uint32_t* line, bool is_vsync, bool is_video_period) const;
+
+  // Puts the Vram bytes, which start at the byte `first_vram_byte` of the Vram line, into the
+  // buffer of the line; the margins and the blanking are left as is. Different parts of a line
+  // may be encoded concurrently.
+  void EncodeLine(uint32_t* line, Span<const uint8_t> vram_bytes, int first_vram_byte) const;
+
+  // The TMDS symbol of the byte per DVI 1.0, updating the running disparity of the lane.
+  static uint16_t EncodeSymbol(uint8_t value, int& disparity);
+
+  // The byte of a data symbol, the inverse of EncodeSymbol().
+  static uint8_t DecodeSymbol(uint16_t symbol);
+
+ private:
+  int image_begin_ = 0;
+  int h_visible_area_ = 0;
+  int h_sync_pulse_front_ = 0;
+  int h_sync_pulse_end_ = 0;
+  int whole_line_ = 0;
+  bool is_hsync_negative_ = false;
+  bool is_vsync_negative_ = false;
+
+  uint32_t color_words_[Vram::kColorCount][kWordsPerPixel];
+  // [V-sync pin level][H-sync pin level].
+  uint32_t control_words_[2][2][kWordsPerPixel];
+
+  // The words of a pixel with the symbols of data lanes 0, 1 and 2.
+  static void ToWords(const uint16_t (&symbols)[3], uint32_t (&words)[kWordsPerPixel]);
+
+  void FillPixels(uint32_t* line, int begin, int end, const uint32_t (&words)[kWordsPerPixel])
+      const;
+};
@@ -17,5 +17,8 @@ struct VideoMode {
   uint8_t v_back_porch;  // Vertical back porch, in TV lines (64 us each).
   uint8_t sync_polarity;  // Bit mask having 1 in positions to be inverted for a negative sync.
   uint8_t h_scale;  // Horizontal scale factor for Vram pixels.
-  uint8_t v_scale;  // Vertical scale factor for Vram scandoubling.
+  uint8_t v_scale;  // Vertical scale factor for Vram scandoubling, or kScaleToFit.
+
+  // For v_scale: stretch the Vram lines over v_visible_area with a non-integer factor.
+  static constexpr uint8_t kScaleToFit = 0;
 };
@@ -1,64 +1,399 @@
-#pragma once
-
-#include <stdint.h>
-#include <string.h>
-
-#include "span.h"
-
-// Frame buffer representing a visible image of a retro computer.
-//
-// Each pixel takes 4 bits - a byte in the buffer represents two pixels, so 16 colors per pixel.
-//
-// The maximum size which fits all known retro computers of interest is defined via constants.
-// The maximum-sized buffer is allocated in order to avoid OOM surprises.
-class Vram {
- public:
-  // TODO: Change the colors to ZX Spectrum; adjust the palette.
-  enum Color: uint8_t{
-      kBlack = 0,
-      kRed = 0x04,
-      kGreen = 0x02,
-      kBlue = 0x01,
-      kMagenta = kRed | kBlue,
-      kYellow = kRed | kGreen,
-      kCyan = kBlue | kGreen,
-      kWhite = kRed | kGreen | kBlue,
-      kBright = 8,  // To be added to other colors.
-      kBrightBlack = kBlack | kBright,  // Shown as black by some retro computers.
-      kBrightRed = kRed | kBright,
-      kBrightGreen = kGreen | kBright,
-      kBrightBlue = kBlue | kBright,
-      kBrightMagenta = kMagenta | kBright,
-      kBrightYellow = kYellow | kBright,
-      kBrightCyan = kCyan | kBright,
-      kBrightWhite = kWhite | kBright,
-      kColorCount
-  };
-  static_assert(kColorCount == 16);
-
-  Vram(int width_px, int height);
-
-  int width_px() const { return width_px_; };
-  int height() const { return height_; }
-
-  void Clear(Color color = kBlack);
-  __force_inline Span<const uint8_t> LineBytes(int y) const {
-    return {buffer_[(ASSERT_CMP(y, >=, 0) && ASSERT_CMP(y, <, height_)) ? y : 0], width_px_ / 2};
-  }
-  __force_inline Span<uint8_t> LineBytes(int y) {
-    return std::as_const(*this).LineBytes(y).AsMutable();
-  }
-
-  void SetPixel(int x, int y, Color color);
-
- private:
-  const int width_px_;
-  const int height_;
-
-  static constexpr int kMaxLineCount = 304;  // Pentagon-128 holds the record.
-  static constexpr int kMaxLinePixelCount = 640;  // ATM Turbo holds the record.
-  static_assert(kMaxLinePixelCount % 2 == 0);
-
-  // 4 bits per pixel.
-  uint8_t buffer_[kMaxLinePixelCount / 2][kMaxLineCount];
-};
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+#include <hardware/sync.h>
+
+#include "span.h"
+
+// The colors of the Vram pixels, common to all the Vram depths; see BasicVram::PixelColor().
+struct VramColors {
+  // TODO: Change the colors to ZX Spectrum; adjust the palette.
+  enum Color: uint8_t{
+      kBlack = 0,
+      kRed = 0x04,
+      kGreen = 0x02,
+      kBlue = 0x01,
+      kMagenta = kRed | kBlue,
+      kYellow = kRed | kGreen,
+      kCyan = kBlue | kGreen,
+      kWhite = kRed | kGreen | kBlue,
+      kBright = 8,  // To be added to other colors.
+      kBrightBlack = kBlack | kBright,  // Shown as black by some retro computers.
+      kBrightRed = kRed | kBright,
+      kBrightGreen = kGreen | kBright,
+      kBrightBlue = kBlue | kBright,
+      kBrightMagenta = kMagenta | kBright,
+      kBrightYellow = kYellow | kBright,
+      kBrightCyan = kCyan | kBright,
+      kBrightWhite = kWhite | kBright,
+      kColorCount
+  };
+  static_assert(kColorCount == 16);
+};
+
+// Frame buffer representing a visible image of a retro computer.
+//
+// Each pixel takes kBpp bits (1, 2, 4 or 8); a byte holds kPixelsPerByte pixels, the first one in
+// the low bits. So with 4 bits, a byte represents two pixels, 16 colors per pixel.
+//
+// The buffer is sized for the picture at compile time. Each line is padded to whole 32-bit words
+// (kStride bytes) and aligned, so that the scanout can read it with aligned 32-bit loads.
+//
+// Lines are accessed via a table of line pointers, which allows optional tear-free drawing (see
+// EnableBackBuffer()): the scanout reads the front lines, and drawing goes to the back lines.
+template <int kBpp, int kWidth, int kHeight>
+class BasicVram: public VramColors {
+ public:
+  static constexpr int kBitsPerPixel = kBpp;
+  static_assert(kBitsPerPixel == 1 || kBitsPerPixel == 2 || kBitsPerPixel == 4
+      || kBitsPerPixel == 8);
+  static constexpr int kPixelsPerByte = 8 / kBitsPerPixel;
+  static constexpr uint8_t kPixelMask = (1 << kBitsPerPixel) - 1;
+
+  static constexpr int kWidthPx = kWidth;
+  static constexpr int kLineCount = kHeight;
+  static_assert(kWidthPx > 0 && kWidthPx % kPixelsPerByte == 0);
+  static_assert(kLineCount > 0);
+  static constexpr int kLineSize = kWidthPx / kPixelsPerByte;  // Bytes of pixels in a line.
+  static constexpr int kStride = (kLineSize + 3) / 4 * 4;  // Bytes between the lines.
+
+  int width_px() const { return kWidthPx; };
+  int height() const { return kLineCount; }
+
+  // The color of the pixel value: with 4 or 8 bits, the value itself (the low 4 bits); with 1
+  // bit, black or bright white. With 2 bits, the value is a gray level from 0 (black) to 3 (bright
+  // white), which has no Color: the colors give only 3 grays, as kBrightBlack is shown as black.
+  static constexpr Color PixelColor(uint8_t pixel) {
+    if constexpr (kBitsPerPixel == 1) {
+      return pixel ? kBrightWhite : kBlack;
+    } else {
+      static_assert(kBitsPerPixel != 2, "The 2-bit pixels are gray levels");
+      return (Color) (pixel % kColorCount);
+    }
+  }
+
+  // The pixel value in each pixel of a word: 0x11111111 times it with 4-bit pixels.
+  static constexpr uint32_t Replicate(uint8_t pixel) {
+    return pixel * (0xFFFF'FFFFu / kPixelMask);
+  }
+
+  BasicVram() {
+    for (int y = 0; y < kLineCount; ++y) {
+      front_lines_[y] = buffer_[y];
+      back_lines_[y] = buffer_[y];
+    }
+  }
+
+  void Clear(uint8_t pixel = kBlack) {
+    ASSERT_CMP(pixel, <=, kPixelMask);
+    uint8_t byte = 0;
+    for (int i = 0; i < kPixelsPerByte; ++i) {
+      byte |= pixel << (i * kBitsPerPixel);
+    }
+    for (int y = 0; y < kLineCount; ++y) {
+      memset(LineBytes(y).data(), byte, kStride);
+      MarkLineDirty(y);
+    }
+  }
+
+  // The front line, as shown by the scanout.
+  __force_inline Span<const uint8_t> LineBytes(int y) const {
+    return {front_lines_[(ASSERT_CMP(y, >=, 0) && ASSERT_CMP(y, <, kLineCount)) ? y : 0],
+        kLineSize};
+  }
+
+  // The back line, to draw into; is the front line unless the back buffer is enabled. The line
+  // must be marked dirty after it is modified, see MarkLineDirty().
+  __force_inline Span<uint8_t> LineBytes(int y) {
+    if (!ASSERT_CMP(y, >=, 0) || !ASSERT_CMP(y, <, kLineCount)) {
+      y = 0;
+    }
+    return {BackLine(y), kLineSize};
+  }
+
+  // With 4 bits per pixel, the pixel value is a Color.
+  void SetPixel(int x, int y, uint8_t pixel) {
+    if (!ASSERT_CMP(pixel, <=, kPixelMask)
+        || !ASSERT_CMP(x, >=, 0)
+        || !ASSERT_CMP(x, <, kWidthPx)
+        || !ASSERT_CMP(y, >=, 0)
+        || !ASSERT_CMP(y, <, kLineCount)) {
+      return;
+    }
+    uint8_t* byte_ptr = &LineBytes(y)[x / kPixelsPerByte];
+    const int shift = x % kPixelsPerByte * kBitsPerPixel;
+    *byte_ptr = (*byte_ptr & ~(kPixelMask << shift)) | (pixel << shift);
+    MarkLineDirty(y);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  // Drawing, a 32-bit word of pixels at a time, with SWAR masks selecting the pixels within the
+  // word; the bounds are checked once per call, so the loops access the lines directly.
+
+  static constexpr int kPixelsPerWord = 32 / kBitsPerPixel;
+
+  // Fills the rectangle, clipped to the Vram.
+  void FillRect(int x, int y, int width, int height, uint8_t pixel) {
+    ASSERT_CMP(pixel, <=, kPixelMask);
+    const uint32_t fill_word = Replicate(pixel);
+    ForEachWord(x, y, width, height, [fill_word](uint32_t& word, uint32_t mask, int, int) {
+      word = (word & ~mask) | (fill_word & mask);
+    });
+  }
+
+  void DrawHorzLine(int x, int y, int length, uint8_t pixel) { FillRect(x, y, length, 1, pixel); }
+  void DrawVertLine(int x, int y, int length, uint8_t pixel) { FillRect(x, y, 1, length, pixel); }
+
+  // Replaces the pixels of the value `from` with `to` in the rectangle, clipped to the Vram.
+  void ReplaceColor(int x, int y, int width, int height, uint8_t from, uint8_t to) {
+    ASSERT_CMP(from, <=, kPixelMask);
+    ASSERT_CMP(to, <=, kPixelMask);
+    const uint32_t to_word = Replicate(to);
+    ForEachWord(x, y, width, height, [from, to_word](uint32_t& word, uint32_t mask, int, int) {
+      mask &= EqualPixelsMask(word, from);
+      word = (word & ~mask) | (to_word & mask);
+    });
+  }
+
+  // Fills the pixels of the rectangle at x, y selected by the mask image, clipped to the Vram. The
+  // mask image is in the Vram format, with all bits of the selected pixels set, and its lines
+  // starting at 32-bit words `mask_stride` words apart.
+  void FillMasked(int x, int y, const uint32_t* mask_image, int width, int height,
+      int mask_stride, uint8_t pixel) {
+    ASSERT_CMP(pixel, <=, kPixelMask);
+    const uint32_t fill_word = Replicate(pixel);
+    const int mask_line_word_count = (width + kPixelsPerWord - 1) / kPixelsPerWord;
+    ForEachWord(x, y, width, height, [&](uint32_t& word, uint32_t mask, int image_x, int image_y) {
+      mask &= ImageBits(mask_image + image_y * mask_stride, mask_line_word_count, image_x);
+      word = (word & ~mask) | (fill_word & mask);
+    });
+  }
+
+  // Copies the image to the rectangle at x, y, clipped to the Vram, skipping the image pixels of
+  // the value `transparent`. The image is in the Vram format, its lines starting at 32-bit words
+  // `image_stride` words apart.
+  void BlitMasked(int x, int y, const uint32_t* image, int width, int height, int image_stride,
+      uint8_t transparent) {
+    ASSERT_CMP(transparent, <=, kPixelMask);
+    const int image_line_word_count = (width + kPixelsPerWord - 1) / kPixelsPerWord;
+    ForEachWord(x, y, width, height, [&](uint32_t& word, uint32_t mask, int image_x, int image_y) {
+      const uint32_t image_word =
+          ImageBits(image + image_y * image_stride, image_line_word_count, image_x);
+      mask &= ~EqualPixelsMask(image_word, transparent);
+      word = (word & ~mask) | (image_word & mask);
+    });
+  }
+
+  // Dirty lines are the ones modified since their dirty mark was last cleared; they allow a
+  // scanout with pre-rendered lines to re-render only the changed ones. The marks are set by
+  // the mutating methods after the modification, and are cleared only explicitly; a mark set
+  // before the modification could be cleared by a re-rendering in between, losing the
+  // modification.
+  //
+  // ATTENTION: Setting and clearing a mark are read-modify-writes of a word. Setting must not
+  // interrupt clearing, or the mark is lost; so ClearLineDirty() disables the interrupts for its
+  // read-modify-write, which lets the marks be cleared at any IRQ priority below the setters,
+  // e.g. OnVblank() and VramDmaFill. The opposite, like clearing in a vblank IRQ handler while
+  // drawing in the main loop, is fine: at worst, a line is re-rendered once more. Both must run
+  // on the same core.
+
+  __force_inline bool IsLineDirty(int y) const {
+    return (dirty_lines_[y / 32] & (1u << (y % 32))) != 0;
+  }
+
+  // Return the first dirty line at or after the given one, or -1 if there is none.
+  int NextDirtyLine(int y) const {
+    for (; y < kLineCount; y = (y / 32 + 1) * 32) {  // Continue from the start of the next word.
+      const uint32_t word = dirty_lines_[y / 32] >> (y % 32);
+      if (word != 0) {
+        const int line = y + __builtin_ctz(word);
+        return (line < kLineCount) ? line : -1;
+      }
+    }
+    return -1;
+  }
+
+  // Must be called after the line is modified via LineBytes(), or by other writers, like the DMA
+  // in VramDmaFill.
+  __force_inline void MarkLineDirty(int y) {
+    std::atomic_signal_fence(std::memory_order_release);  // After the writes of the line.
+    if (y >= 0 && y < kLineCount) {
+      dirty_lines_[y / 32] = dirty_lines_[y / 32] | (1u << (y % 32));
+    }
+  }
+
+  __force_inline void ClearLineDirty(int y) {
+    const uint32_t interrupts = save_and_disable_interrupts();
+    dirty_lines_[y / 32] = dirty_lines_[y / 32] & ~(1u << (y % 32));
+    restore_interrupts(interrupts);
+  }
+
+  // See MarkLineDirty(). A word operation per 32 lines, so that it is short in an IRQ handler.
+  void MarkLinesDirty(int begin_y, int end_y) {
+    std::atomic_signal_fence(std::memory_order_release);  // After the writes of the lines.
+    begin_y = std::max(begin_y, 0);
+    end_y = std::min(end_y, kLineCount);
+    for (int y = begin_y; y < end_y; y = (y / 32 + 1) * 32) {
+      const int count = std::min(end_y - y, 32 - y % 32);
+      const uint32_t mask = ((count == 32) ? 0xFFFF'FFFFu : (1u << count) - 1) << (y % 32);
+      dirty_lines_[y / 32] = dirty_lines_[y / 32] | mask;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  // Tear-free drawing.
+  //
+  // When the back buffer is enabled, the first modification of a line after a flip copies the
+  // front line into a spare line, which becomes the back line; the scanout keeps showing the
+  // front line. Flip() makes the back lines the front ones at the start of the next vertical
+  // blanking, and the replaced front lines become spare. Thus, the back buffer costs only
+  // kSpareLineCount lines of RAM, and up to kSpareLineCount lines can be modified between flips;
+  // further lines are modified in the front, so they may tear.
+
+  static constexpr int kSpareLineCount = 32;
+
+  // Must be called when nothing is drawn, e.g. before starting to draw an animation.
+  void EnableBackBuffer() {
+    is_back_buffer_enabled_ = true;
+    free_spare_line_count_ = 0;
+    for (auto& spare_line: spare_lines_) {
+      free_spare_lines_[free_spare_line_count_++] = spare_line;
+    }
+  }
+
+  // Make the modifications since the previous flip visible at the start of the next vertical
+  // blanking, and return after that. Must not be called from an IRQ handler or with no scanout.
+  void Flip() {
+    if (!is_back_buffer_enabled_) {
+      return;
+    }
+    is_flip_requested_.store(true, std::memory_order_release);
+    while (is_flip_requested_.load(std::memory_order_acquire)) {
+      tight_loop_contents();
+    }
+  }
+
+  // Wait until the start of the next vertical blanking. Must not be called from an IRQ handler
+  // or with no scanout.
+  void WaitForVblank() const {
+    const uint32_t vblank_count = this->vblank_count();
+    while (this->vblank_count() == vblank_count) {
+      tight_loop_contents();
+    }
+  }
+
+  // Number of vertical blankings since the start; see OnVblank().
+  __force_inline uint32_t vblank_count() const {
+    return vblank_count_.load(std::memory_order_acquire);
+  }
+
+  // Must be called by the scanout at the start of each vertical blanking, when the DMA has
+  // finished reading the visible lines, and before any line of the next frame is read. Lines
+  // changed by a flip are marked dirty.
+  void __not_in_flash_func(OnVblank)() {
+    if (is_flip_requested_.load(std::memory_order_acquire)) {
+      for (int y = 0; y < kLineCount; ++y) {
+        if (back_lines_[y] != front_lines_[y]) {
+          free_spare_lines_[free_spare_line_count_++] = front_lines_[y];
+          front_lines_[y] = back_lines_[y];
+          MarkLineDirty(y);
+        }
+      }
+      is_flip_requested_.store(false, std::memory_order_release);
+    }
+    vblank_count_.store(
+        vblank_count_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+ private:
+  alignas(4) uint8_t buffer_[kLineCount][kStride];
+
+  // Bit per line, see IsLineDirty().
+  volatile uint32_t dirty_lines_[(kLineCount + 31) / 32]{};
+
+  // Lines are interchangeable between buffer_ and spare_lines_; which ones are the front, the back
+  // and the spare ones changes with the flips.
+  alignas(4) uint8_t spare_lines_[kSpareLineCount][kStride];
+  uint8_t* front_lines_[kLineCount];
+  uint8_t* back_lines_[kLineCount];
+  uint8_t* free_spare_lines_[kSpareLineCount];
+  int free_spare_line_count_ = 0;
+  bool is_back_buffer_enabled_ = false;
+  std::atomic<bool> is_flip_requested_ = false;
+  std::atomic<uint32_t> vblank_count_ = 0;
+
+  // The bits of the pixels of the word which are equal to the pixel value.
+  static __force_inline uint32_t EqualPixelsMask(uint32_t word, uint8_t pixel) {
+    uint32_t diff = word ^ Replicate(pixel);
+    for (int shift = 1; shift < kBitsPerPixel; shift *= 2) {  // Gather the bits at the pixel LSB.
+      diff |= diff >> shift;
+    }
+    return ~((diff & Replicate(1)) * kPixelMask);
+  }
+
+  // The bits of the pixels from `begin` to `end` of a word.
+  static __force_inline uint32_t PixelRangeMask(int begin, int end) {
+    const uint32_t end_mask =
+        (end == kPixelsPerWord) ? 0xFFFF'FFFFu : (1u << (end * kBitsPerPixel)) - 1;
+    return end_mask & ~((1u << (begin * kBitsPerPixel)) - 1);
+  }
+
+  // A word of the image line starting at the pixel image_x, which may be negative; the pixels
+  // outside of the line are 0.
+  static __force_inline uint32_t ImageBits(const uint32_t* line, int word_count, int image_x) {
+    const int bit_offset = image_x * kBitsPerPixel;
+    const int index = bit_offset >> 5;  // Rounded down.
+    const int shift = bit_offset & 31;
+    const auto word_at = [line, word_count](int i) {
+      return (i >= 0 && i < word_count) ? line[i] : 0;
+    };
+    const uint32_t low_word = word_at(index);
+    return (shift == 0) ? low_word : (low_word >> shift) | (word_at(index + 1) << (32 - shift));
+  }
+
+  // Calls `func(word, mask, image_x, image_y)` for each Vram word overlapping the rectangle clipped
+  // to the Vram, where `mask` selects the pixels of the rectangle in the word, and image_x and
+  // image_y are the position of the first pixel of the word relative to the rectangle.
+  template <typename Func>
+  __force_inline void ForEachWord(int x, int y, int width, int height, Func func) {
+    const int begin_x = std::max(x, 0);
+    const int end_x = std::min(x + width, kWidthPx);
+    const int begin_y = std::max(y, 0);
+    const int end_y = std::min(y + height, kLineCount);
+    if (begin_x >= end_x) {
+      return;
+    }
+    const int begin_word = begin_x / kPixelsPerWord;
+    const int last_word = (end_x - 1) / kPixelsPerWord;
+    const uint32_t begin_mask = PixelRangeMask(begin_x % kPixelsPerWord, kPixelsPerWord);
+    const uint32_t last_mask = PixelRangeMask(0, (end_x - 1) % kPixelsPerWord + 1);
+    for (int line_y = begin_y; line_y < end_y; ++line_y) {
+      uint32_t* const line = (uint32_t*) BackLine(line_y);
+      for (int i = begin_word; i <= last_word; ++i) {
+        const uint32_t mask = ((i == begin_word) ? begin_mask : 0xFFFF'FFFFu)
+            & ((i == last_word) ? last_mask : 0xFFFF'FFFFu);
+        func(line[i], mask, i * kPixelsPerWord - x, line_y - y);
+      }
+    }
+    MarkLinesDirty(begin_y, end_y);  // After the writes, see the dirty lines.
+  }
+
+  // Copy the front line to a spare one on the first modification after a flip.
+  __force_inline uint8_t* BackLine(int y) {
+    if (is_back_buffer_enabled_
+        && back_lines_[y] == front_lines_[y]
+        && free_spare_line_count_ > 0) {
+      back_lines_[y] = free_spare_lines_[--free_spare_line_count_];
+      memcpy(back_lines_[y], front_lines_[y], kStride);
+    }
+    return back_lines_[y];
+  }
+};
+
+// The Vram of the firmware: the 16-color 256x256 picture of Agat-7, which all the video modes
+// show. Other depths are expanded by the Palette-based scanouts only, see main.cpp.
+using Vram = BasicVram<4, 256, 256>;
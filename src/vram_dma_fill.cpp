@@ -0,0 +1,132 @@
+#include "vram_dma_fill.h"
+
+#include <algorithm>
+
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+
+#include "debug.h"
+
+namespace {
+
+VramDmaFill* instance = nullptr;  // For the IRQ handler.
+
+}  // namespace
+
+void VramDmaFill::Init(Vram& vram) {
+  if (!ASSERT(instance == nullptr, "VramDmaFill is already initialized")) {
+    return;
+  }
+  instance = this;
+  vram_ = &vram;
+  data_dma_ch_ = dma_claim_unused_channel(true);
+  control_dma_ch_ = dma_claim_unused_channel(true);
+
+  // Data: no DREQ, so it runs whenever the higher-priority channels have no transfer to do.
+  // Raises an IRQ only on the null trigger at the end of the table.
+  dma_channel_config data_config = dma_channel_get_default_config(data_dma_ch_);
+  channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&data_config, false);
+  channel_config_set_write_increment(&data_config, true);
+  channel_config_set_chain_to(&data_config, control_dma_ch_);
+  channel_config_set_irq_quiet(&data_config, true);
+  dma_channel_configure(
+      data_dma_ch_,
+      &data_config,
+      /*write_addr=*/nullptr,  // Set by the control channel.
+      /*read_addr=*/&fill_word_,
+      /*encoded_transfer_count=*/0,  // Set by StartFillRect().
+      /*trigger=*/false  // Don't start yet.
+  );
+
+  // Control: writes a line address per data transfer; the transfer count of the data channel is
+  // reloaded on each trigger.
+  dma_channel_config control_config = dma_channel_get_default_config(control_dma_ch_);
+  channel_config_set_transfer_data_size(&control_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&control_config, true);
+  channel_config_set_write_increment(&control_config, false);
+  channel_config_set_chain_to(&control_config, control_dma_ch_);  // Itself means no chaining.
+  dma_channel_configure(
+      control_dma_ch_,
+      &control_config,
+      /*write_addr=*/&dma_hw->ch[data_dma_ch_].al2_write_addr_trig,
+      /*read_addr=*/&line_words_[0],
+      /*encoded_transfer_count=*/1,
+      /*trigger=*/false  // Don't start yet.
+  );
+
+  dma_channel_set_irq1_enabled(data_dma_ch_, /*enabled=*/true);
+  irq_add_shared_handler(DMA_IRQ_1, OnDmaIrq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_priority(DMA_IRQ_1, PICO_LOWEST_IRQ_PRIORITY);
+  irq_set_enabled(DMA_IRQ_1, /*enabled=*/true);
+}
+
+void VramDmaFill::WaitUntilDone() const {
+  while (IsBusy()) {
+    tight_loop_contents();
+  }
+}
+
+void VramDmaFill::StartClear(uint8_t pixel, Callback on_done) {
+  StartFillRect(0, 0, Vram::kWidthPx, Vram::kLineCount, pixel, on_done);
+}
+
+void VramDmaFill::StartFillRect(
+    int x, int y, int width, int height, uint8_t pixel, Callback on_done) {
+  if (!ASSERT(vram_ != nullptr, "VramDmaFill is not initialized")
+      || !ASSERT_CMP(pixel, <=, Vram::kPixelMask)) {
+    return;
+  }
+  WaitUntilDone();
+
+  const int begin_x = std::max(x, 0);
+  const int end_x = std::min(x + width, Vram::kWidthPx);
+  const int begin_y = std::max(y, 0);
+  const int end_y = std::min(y + height, Vram::kLineCount);
+  constexpr int kPixelsPerWord = Vram::kPixelsPerWord;
+  const int begin_word = (begin_x + kPixelsPerWord - 1) / kPixelsPerWord;
+  const int end_word = end_x / kPixelsPerWord;
+
+  // The partial words at the edges are filled by the CPU, as well as a rectangle without whole
+  // words.
+  if (begin_y >= end_y || begin_word >= end_word) {
+    vram_->FillRect(begin_x, begin_y, end_x - begin_x, end_y - begin_y, pixel);
+    if (on_done != nullptr) {
+      on_done();
+    }
+    return;
+  }
+  const int inner_begin_x = begin_word * kPixelsPerWord;
+  const int inner_end_x = end_word * kPixelsPerWord;
+  vram_->FillRect(begin_x, begin_y, inner_begin_x - begin_x, end_y - begin_y, pixel);
+  vram_->FillRect(inner_end_x, begin_y, end_x - inner_end_x, end_y - begin_y, pixel);
+
+  // LineBytes() switches to the back lines; they are marked dirty on completion, after the DMA
+  // has written them.
+  for (int line_y = begin_y; line_y < end_y; ++line_y) {
+    line_words_[line_y - begin_y] = (uint32_t*) vram_->LineBytes(line_y).data() + begin_word;
+  }
+  line_words_[end_y - begin_y] = nullptr;
+  fill_word_ = Vram::Replicate(pixel);
+  begin_y_ = begin_y;
+  end_y_ = end_y;
+  on_done_ = on_done;
+  is_busy_.store(true, std::memory_order_release);
+
+  dma_channel_set_trans_count(data_dma_ch_, end_word - begin_word, /*trigger=*/false);
+  dma_channel_set_read_addr(control_dma_ch_, &line_words_[0], /*trigger=*/true);
+}
+
+void __not_in_flash_func(VramDmaFill::OnDmaIrq)() {
+  VramDmaFill* const fill = instance;
+  if ((dma_hw->ints1 & (1u << fill->data_dma_ch_)) == 0) {
+    return;  // Another handler's IRQ.
+  }
+  dma_hw->ints1 = 1u << fill->data_dma_ch_;
+  fill->vram_->MarkLinesDirty(fill->begin_y_, fill->end_y_);
+  const Callback on_done = fill->on_done_;
+  fill->is_busy_.store(false, std::memory_order_release);
+  if (on_done != nullptr) {
+    on_done();
+  }
+}
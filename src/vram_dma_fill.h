@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include <pico.h>
+
+#include "vram.h"
+
+// Clears and rectangle fills of the Vram done by a pair of spare DMA channels, asynchronously:
+// the CPU only makes a table of the line addresses and fills the partial words at the rectangle
+// edges, then the DMA writes the whole words, reading the replicated pixel word with the read
+// increment off.
+//
+// The data channel writes the words of a line, and chains to the control channel, which walks
+// the table, writing the address of the next line to the data channel trigger; the null entry at
+// the end makes the data channel raise DMA_IRQ_1, where the completion callback is called. The
+// IRQ is shared with the second output; its priority is the lowest, unless the second output
+// raises it, see start_second_output() in main.cpp.
+//
+// The RP2040 bus priority is per bus master, so it cannot favor one DMA channel over another;
+// instead, the scanout channels are high priority in the DMA scheduler, and the fill channels
+// are not, so the fill only takes the DMA cycles the scanout leaves, and never starves it.
+class VramDmaFill {
+ public:
+  using Callback = void (*)();
+
+  // Claims the DMA channels and adds the IRQ handler; only one instance can be initialized.
+  void Init(Vram& vram);
+
+  bool IsBusy() const { return is_busy_.load(std::memory_order_acquire); }
+
+  // Must not be called from an IRQ handler.
+  void WaitUntilDone() const;
+
+  // The fills wait for the previous one to complete. Until `on_done` is called, the Vram must not
+  // be flipped, and the rectangle must not be drawn into. `on_done` is called from the IRQ
+  // handler, or before returning if the fill needs no DMA; with the second output, the IRQ has
+  // the priority of the scanout, so `on_done` must be short.
+  void StartClear(uint8_t pixel = Vram::kBlack, Callback on_done = nullptr);
+
+  // Fills the rectangle, clipped to the Vram; see StartClear().
+  void StartFillRect(
+      int x, int y, int width, int height, uint8_t pixel, Callback on_done = nullptr);
+
+ private:
+  Vram* vram_ = nullptr;
+  int data_dma_ch_ = -1;
+  int control_dma_ch_ = -1;
+
+  uint32_t fill_word_ = 0;  // Read by the data channel.
+  uint32_t* line_words_[Vram::kLineCount + 1];  // Read by the control channel; null-terminated.
+  int begin_y_ = 0;
+  int end_y_ = 0;
+  Callback on_done_ = nullptr;
+  std::atomic<bool> is_busy_ = false;
+
+  static void OnDmaIrq();
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+// The interpolator configuration of expand_vram_words_via_interp() in main.cpp, shared with its
+// host test, which models the interpolator. interp0 and interp1 are configured alike; the CPU
+// writes the Vram word to the accumulator 0 of each, pre-shifted to put byte 0 (interp0) or byte 2
+// (interp1) into bits 2..9, i.e. pre-scaled to the 4-byte LUT entry. Lane 0 takes these bits, and
+// lane 1 (cross-input) bits 10..17, i.e. the next byte; BASE of both lanes is the LUT address.
+struct VramInterpLanes {
+  // The fields of the SDK interp_config, see interp_config_set_*().
+  struct Lane {
+    int shift;
+    int mask_lsb;
+    int mask_msb;
+    bool is_cross_input;
+  };
+
+  static constexpr Lane kLanes[2]{
+      {.shift = 0, .mask_lsb = 2, .mask_msb = 9, .is_cross_input = false},
+      {.shift = 8, .mask_lsb = 2, .mask_msb = 9, .is_cross_input = true},
+  };
+
+  // The accumulator 0 of interp0 or interp1 for the Vram word.
+  static constexpr uint32_t Accum0(int interp_index, uint32_t vram_word) {
+    return (interp_index == 0) ? vram_word << 2 : vram_word >> 14;
+  }
+};
@@ -0,0 +1,147 @@
+#include "agat7_renderer.h"
+
+#include <chrono>
+#include <string.h>
+
+#include "agat7_font.h"
+#include "test.h"
+
+// Checks the word-wide drawing of Agat7Renderer against the per-pixel and per-byte code it
+// replaced, and prints the timings of both on the host. The host timings only hint at the ratio on
+// the RP2040, which has no data cache; see the startup messages with -DPROFILE=on on a board.
+
+namespace {
+
+Vram vram;
+Vram reference_vram;
+
+// Some pixels of every color under the text, to see that the unlit glyph pixels keep them.
+void DrawBackground(Vram& target) {
+  for (int y = 0; y < Vram::kLineCount; ++y) {
+    for (int x = 0; x < Vram::kWidthPx; ++x) {
+      target.SetPixel(x, y, (x / 3 + y) % Vram::kColorCount);
+    }
+  }
+}
+
+// Every character in every color, at every column parity.
+void PrintAllCharacters(Agat7Renderer& renderer) {
+  for (int text_y = 0; text_y < Agat7Renderer::kTextHeight; ++text_y) {
+    char line[Agat7Renderer::kTextWidth + 1]{};
+    for (int text_x = 0; text_x < Agat7Renderer::kTextWidth; ++text_x) {
+      line[text_x] = (char) (32 + (text_y * Agat7Renderer::kTextWidth + text_x) % 96);
+    }
+    renderer.PrintAt(0, text_y, line, Agat7Renderer::kColors[text_y % 16],
+        Agat7Renderer::PrintMode::kAllowRussian);
+  }
+}
+
+// The per-pixel RenderTextBuffer() before the glyph masks, with the text of PrintAllCharacters().
+void RenderReferenceText(Vram& target, Agat7Renderer::TextComposite text_composite) {
+  constexpr auto kFont = agat7_font();
+  constexpr int kMargin = (Vram::kWidthPx - Agat7Renderer::kTextWidth * Agat7Renderer::kCharWidth)
+      / 2;
+  for (int text_y = 0; text_y < Agat7Renderer::kTextHeight; ++text_y) {
+    for (int text_x = 0; text_x < Agat7Renderer::kTextWidth; ++text_x) {
+      const int c = (text_y * Agat7Renderer::kTextWidth + text_x) % 96;
+      for (int row = 0; row < Agat7Renderer::kCharHeight; ++row) {
+        for (int column = 0; column < Agat7Renderer::kCharWidth; ++column) {
+          const bool is_lit = (kFont[c][row] & (1 << (7 - column))) != 0;
+          if (is_lit || text_composite == Agat7Renderer::TextComposite::kOpaque) {
+            target.SetPixel(kMargin + text_x * Agat7Renderer::kCharWidth + column,
+                text_y * Agat7Renderer::kCharHeight + row,
+                is_lit ? Agat7Renderer::kColors[text_y % 16] : Vram::kBlack);
+          }
+        }
+      }
+    }
+  }
+}
+
+// The per-byte DrawHorzLineMgr() and DrawVertLineMgr() before FillRect(), with the dirty mark which
+// LineBytes() made then on every call.
+void DrawReferenceLinesMgr(Vram& target) {
+  for (int i = 0; i < 64; ++i) {
+    const uint8_t byte = (Vram::kRed << 4) | Vram::kRed;
+    for (int byte_idx = i; byte_idx < 128; ++byte_idx) {
+      target.LineBytes(i * 2)[byte_idx] = byte;
+      target.MarkLineDirty(i * 2);
+      target.LineBytes(i * 2 + 1)[byte_idx] = byte;
+      target.MarkLineDirty(i * 2 + 1);
+    }
+    for (int y = i * 2; y < 128 * 2; ++y) {
+      target.LineBytes(y)[i] = (Vram::kGreen << 4) | Vram::kGreen;
+      target.MarkLineDirty(y);
+    }
+  }
+}
+
+void DrawLinesMgr(Agat7Renderer& renderer) {
+  for (int i = 0; i < 64; ++i) {
+    renderer.DrawHorzLineMgr(i, i, 128 - i, Vram::kRed);
+    renderer.DrawVertLineMgr(i, i, 128 - i, Vram::kGreen);
+  }
+}
+
+bool CheckVramsAreEqual() {
+  for (int y = 0; y < Vram::kLineCount; ++y) {
+    const Vram& const_vram = vram;
+    const Vram& const_reference_vram = reference_vram;
+    if (!CHECK(memcmp(const_vram.LineBytes(y).data(), const_reference_vram.LineBytes(y).data(),
+        Vram::kLineSize) == 0)) {
+      printf("  Line %d\n", y);
+      return false;
+    }
+  }
+  return true;
+}
+
+// The best of several runs, in microseconds.
+template <typename Func>
+double TimeUs(Func func) {
+  double best_us = 1e30;
+  for (int run = 0; run < 100; ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::micro> duration =
+        std::chrono::steady_clock::now() - start;
+    best_us = std::min(best_us, duration.count());
+  }
+  return best_us;
+}
+
+}  // namespace
+
+TEST(TextMatchesThePerPixelRendering) {
+  Agat7Renderer renderer(vram);
+  PrintAllCharacters(renderer);
+  for (const auto text_composite:
+      {Agat7Renderer::TextComposite::kTransparent, Agat7Renderer::TextComposite::kOpaque}) {
+    DrawBackground(vram);
+    renderer.RenderTextBuffer(text_composite);
+    DrawBackground(reference_vram);
+    RenderReferenceText(reference_vram, text_composite);
+    if (!CheckVramsAreEqual()) {
+      return;
+    }
+  }
+  printf("  Host timing of 32x32 characters: %.0f us; per pixel: %.0f us\n",
+      TimeUs([&] { renderer.RenderTextBuffer(); }),
+      TimeUs([] {
+        RenderReferenceText(reference_vram, Agat7Renderer::TextComposite::kTransparent);
+      }));
+}
+
+TEST(LinesMatchThePerByteRendering) {
+  Agat7Renderer renderer(vram);
+  DrawBackground(vram);
+  DrawLinesMgr(renderer);
+  DrawBackground(reference_vram);
+  DrawReferenceLinesMgr(reference_vram);
+  if (!CheckVramsAreEqual()) {
+    return;
+  }
+  printf("  Host timing of 128 MGR lines: %.0f us; per byte: %.0f us\n",
+      TimeUs([&] { DrawLinesMgr(renderer); }),
+      TimeUs([] { DrawReferenceLinesMgr(reference_vram); }));
+}
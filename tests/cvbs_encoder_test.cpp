@@ -0,0 +1,150 @@
+#include "cvbs_encoder.h"
+
+#include <math.h>
+#include <vector>
+
+#include "test.h"
+
+// Decodes the lines made by CvbsEncoder like a PAL TV does, and checks that the color bars come
+// back: the burst at the tail of the previous buffer gives the V-switch of the line, and the
+// luma and the U and V components of each bar give its R, G and B.
+
+namespace {
+
+// The line layout of kVideoModeCvbs in main.cpp; only these fields are used by the encoder.
+constexpr VideoMode kVideoMode{
+    .h_visible_area = 1092,
+    .whole_line = CvbsEncoder::kLineSampleCount,
+    .h_front_porch = 36,
+    .h_sync_pulse = 100,
+    .h_back_porch = 116,
+    .h_scale = CvbsEncoder::kSamplesPerPixel,
+};
+constexpr int kImageBegin = (1092 / CvbsEncoder::kSamplesPerPixel - Vram::kWidthPx) / 2 * 4;
+
+// The burst, 5.6 us after the leading edge of H-sync, for 10 subcarrier cycles.
+constexpr int kBurstBegin = 1092 + 36 + CvbsEncoder::kLineSampleCount * 56 / 640;
+constexpr int kBurstEnd = kBurstBegin + CvbsEncoder::kLineSampleCount * 1000 / 28375;
+
+constexpr int kBarWidthPx = Vram::kWidthPx / Vram::kColorCount;  // All colors in a line.
+
+// The subcarrier of the TV, in cycles: continuous over the lines, so that each line starts 0.75
+// cycles later in the phase than the previous one.
+double SubcarrierCycles(int y, int sample) {
+  return (y * CvbsEncoder::kLineSampleCount + sample) * 283.75 / CvbsEncoder::kLineSampleCount;
+}
+
+// The level above the blank level, and the U and V components, in units of the white level,
+// fitted by least squares to the samples: level = y + u * sin + v * cos.
+struct Yuv {
+  double y;
+  double u;
+  double v;
+};
+
+Yuv Demodulate(const uint8_t* line, int y, int begin, int end) {
+  double sums[3][3]{};  // Of the products of the basis functions: 1, sin, cos.
+  double rhs[3]{};
+  for (int sample = begin; sample < end; ++sample) {
+    const double angle = 2 * M_PI * SubcarrierCycles(y, sample);
+    const double basis[3]{1, sin(angle), cos(angle)};
+    const double level = (double) (line[sample] - CvbsEncoder::kBlankLevel)
+        / (CvbsEncoder::kWhiteLevel - CvbsEncoder::kBlankLevel);
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        sums[i][j] += basis[i] * basis[j];
+      }
+      rhs[i] += basis[i] * level;
+    }
+  }
+  // Cramer's rule.
+  const auto det = [](const double (&m)[3][3]) {
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+        - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+        + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+  };
+  double result[3];
+  for (int k = 0; k < 3; ++k) {
+    double m[3][3];
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        m[i][j] = (j == k) ? rhs[i] : sums[i][j];
+      }
+    }
+    result[k] = det(m) / det(sums);
+  }
+  return {result[0], result[1], result[2]};
+}
+
+std::vector<uint8_t> MakeColorBarsLine() {
+  std::vector<uint8_t> vram_line(Vram::kLineSize);
+  for (int x = 0; x < Vram::kWidthPx; x += 2) {
+    const uint8_t color = x / kBarWidthPx;
+    vram_line[x / 2] = color | (color << 4);
+  }
+  return vram_line;
+}
+
+// The R, G or B level shown by the RGB outputs for the color: 2/3 for a normal color, 1 for a
+// bright one.
+double ChannelLevel(int color, int channel_bit) {
+  return (color & channel_bit) ? ((color & Vram::kBright) ? 1.0 : 2.0 / 3) : 0.0;
+}
+
+}  // namespace
+
+TEST(BurstHasTheVSwitchOfTheNextBuffer) {
+  CvbsEncoder encoder;
+  encoder.Init(kVideoMode, kImageBegin);
+  const std::vector<uint8_t> vram_line = MakeColorBarsLine();
+  std::vector<uint8_t> line(CvbsEncoder::kLineSampleCount, CvbsEncoder::kBlankLevel);
+  for (int y = 0; y < 8; ++y) {
+    encoder.EncodeLine(line.data(), y, {vram_line.data(), (int) vram_line.size()});
+    const Yuv burst = Demodulate(line.data(), y, kBurstBegin, kBurstEnd);
+    // 135 degrees (-U +V) for the line y + 1 with the V-switch off, i.e. an even one, and 225
+    // degrees (-U -V) for an odd one; 0.3 V peak-to-peak, i.e. 3/7 of the white level.
+    constexpr double kComponent = 0.3 / 2 / 0.7 / M_SQRT2;
+    const double v_sign = ((y + 1) % 2 == 0) ? 1 : -1;
+    if (!CHECK(fabs(burst.y) < 0.02)
+        || !CHECK(fabs(burst.u + kComponent) < 0.02)
+        || !CHECK(fabs(burst.v - v_sign * kComponent) < 0.02)) {
+      printf("  Line %d: burst %.3f %.3f %.3f\n", y, burst.y, burst.u, burst.v);
+    }
+  }
+}
+
+TEST(ColorBarsAreDecoded) {
+  CvbsEncoder encoder;
+  encoder.Init(kVideoMode, kImageBegin);
+  const std::vector<uint8_t> vram_line = MakeColorBarsLine();
+  std::vector<uint8_t> previous_line(CvbsEncoder::kLineSampleCount, CvbsEncoder::kBlankLevel);
+  std::vector<uint8_t> line(CvbsEncoder::kLineSampleCount, CvbsEncoder::kBlankLevel);
+  encoder.EncodeLine(previous_line.data(), 0, {vram_line.data(), (int) vram_line.size()});
+
+  // A whole phase period of lines, and both V-switch states.
+  for (int y = 1; y <= 2 * CvbsEncoder::kLinePhasePeriod; ++y) {
+    encoder.EncodeLine(line.data(), y, {vram_line.data(), (int) vram_line.size()});
+    // The TV line starts at the H-sync pulse in the previous buffer, with its burst.
+    const Yuv burst = Demodulate(previous_line.data(), y - 1, kBurstBegin, kBurstEnd);
+    const double v_sign = (burst.v > 0) ? 1 : -1;
+
+    for (int color = 0; color < Vram::kColorCount; ++color) {
+      // The middle of the bar, away from the edges.
+      const int begin = kImageBegin + (color * kBarWidthPx + 2) * CvbsEncoder::kSamplesPerPixel;
+      const int end = begin + (kBarWidthPx - 4) * CvbsEncoder::kSamplesPerPixel;
+      const Yuv yuv = Demodulate(line.data(), y, begin, end);
+      const double r = yuv.y + v_sign * yuv.v / 0.877;
+      const double b = yuv.y + yuv.u / 0.493;
+      const double g = (yuv.y - 0.299 * r - 0.114 * b) / 0.587;
+      // The 64 phases of the sample tables put up to 2.8 degrees of phase error on the chroma,
+      // which shows the most in B, at 1 / 0.493 of U.
+      constexpr double kTolerance = 0.1;
+      if (!CHECK(fabs(r - ChannelLevel(color, Vram::kRed)) < kTolerance)
+          || !CHECK(fabs(g - ChannelLevel(color, Vram::kGreen)) < kTolerance)
+          || !CHECK(fabs(b - ChannelLevel(color, Vram::kBlue)) < kTolerance)) {
+        printf("  Line %d, color %d: RGB %.3f %.3f %.3f\n", y, color, r, g, b);
+      }
+    }
+    std::swap(line, previous_line);
+  }
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <pico.h>
+
+static inline uint pio_encode_delay(uint cycles) { return cycles << 8u; }
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <pico.h>
+
+// Only declared: debug::CycleStats is not used by the code under test.
+typedef struct {
+  volatile uint32_t csr;
+  volatile uint32_t rvr;
+  volatile uint32_t cvr;
+  volatile uint32_t calib;
+} systick_hw_t;
+
+extern systick_hw_t* systick_hw;
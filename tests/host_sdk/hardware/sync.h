@@ -0,0 +1,7 @@
+#pragma once
+
+#include <pico.h>
+
+// The host tests run the code under test on a single thread, without IRQs.
+static inline uint32_t save_and_disable_interrupts() { return 0; }
+static inline void restore_interrupts(uint32_t) {}
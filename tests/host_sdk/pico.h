@@ -0,0 +1,15 @@
+#pragma once
+
+// The part of the Pico SDK used by the src/ code under test, for the host build.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+#define __force_inline inline __attribute__((always_inline))
+#define __not_in_flash_func(func_name) func_name
+#define __printflike(fmt_arg, first_vararg) __attribute__((format(printf, fmt_arg, first_vararg)))
+
+static inline void tight_loop_contents() {}
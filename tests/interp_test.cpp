@@ -0,0 +1,93 @@
+#include "vram_interp_lanes.h"
+
+#include <array>
+
+#include "test.h"
+
+// Checks the lane arithmetic of expand_vram_words_via_interp() in main.cpp against the C loop of
+// expand_vram_words_via_cpu(), on a software model of the RP2040 interpolator.
+
+namespace {
+
+// The interpolator, per the RP2040 datasheet (2.3.1.6): the input of a lane, which is its
+// accumulator or, with CROSS_INPUT, the one of the other lane, is rotated right by SHIFT, masked to
+// the bits MASK_LSB..MASK_MSB, and added to BASE of the lane to give PEEK. The lanes are configured
+// by VramInterpLanes, like in expand_vram_words_via_interp(); BASE is the LUT byte offset instead
+// of its address, which does not fit 32 bits on the host.
+struct InterpModel {
+  std::array<uint32_t, 2> accum{};
+  std::array<uint32_t, 2> base{};
+
+  uint32_t Peek(int lane) const {
+    const VramInterpLanes::Lane& config = VramInterpLanes::kLanes[lane];
+    const uint32_t input = accum[config.is_cross_input ? 1 - lane : lane];
+    const uint32_t rotated = (config.shift == 0)
+        ? input : (input >> config.shift) | (input << (32 - config.shift));
+    const uint32_t mask =
+        (0xFFFF'FFFFu >> (31 - config.mask_msb)) & (0xFFFF'FFFFu << config.mask_lsb);
+    return base[lane] + (rotated & mask);
+  }
+};
+
+// A DoubledPalette stand-in, with a distinct word per byte.
+std::array<uint32_t, 256> MakeLut() {
+  std::array<uint32_t, 256> lut;
+  for (int byte = 0; byte < 256; ++byte) {
+    lut[byte] = 0x9E37'79B9u * (byte + 1);
+  }
+  return lut;
+}
+
+const std::array<uint32_t, 256> lut = MakeLut();
+
+uint32_t LutWordAtOffset(uint32_t byte_offset) {
+  return *(const uint32_t*) ((const uint8_t*) lut.data() + byte_offset);
+}
+
+// The 4 DMA buffer words of a Vram word, as the interp kernel produces them.
+std::array<uint32_t, 4> ExpandViaInterp(uint32_t vram_word) {
+  InterpModel interp0;
+  InterpModel interp1;
+  interp0.accum[0] = VramInterpLanes::Accum0(0, vram_word);
+  interp1.accum[0] = VramInterpLanes::Accum0(1, vram_word);
+  return {
+      LutWordAtOffset(interp0.Peek(0)),
+      LutWordAtOffset(interp0.Peek(1)),
+      LutWordAtOffset(interp1.Peek(0)),
+      LutWordAtOffset(interp1.Peek(1)),
+  };
+}
+
+// The same, as the CPU kernel produces them.
+std::array<uint32_t, 4> ExpandViaCpu(uint32_t vram_word) {
+  return {
+      lut[vram_word & 0xFF],
+      lut[(vram_word >> 8) & 0xFF],
+      lut[(vram_word >> 16) & 0xFF],
+      lut[vram_word >> 24],
+  };
+}
+
+}  // namespace
+
+TEST(EachByteInEachPosition) {
+  for (int byte = 0; byte < 256; ++byte) {
+    for (int position = 0; position < 4; ++position) {
+      // The other bytes are set, so that a too wide mask shows.
+      const uint32_t vram_word = ~(0xFFu << (position * 8)) | ((uint32_t) byte << (position * 8));
+      if (!CHECK(ExpandViaInterp(vram_word) == ExpandViaCpu(vram_word))) {
+        return;
+      }
+    }
+  }
+}
+
+TEST(PseudoRandomWords) {
+  uint32_t vram_word = 1;
+  for (int i = 0; i < 100'000; ++i) {
+    vram_word = vram_word * 1'664'525u + 1'013'904'223u;  // Numerical Recipes LCG.
+    if (!CHECK(ExpandViaInterp(vram_word) == ExpandViaCpu(vram_word))) {
+      return;
+    }
+  }
+}
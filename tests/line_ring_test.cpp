@@ -0,0 +1,108 @@
+#include "line_ring.h"
+
+#include <atomic>
+#include <thread>
+
+#include "test.h"
+
+namespace {
+
+constexpr int kLineSize = 16;
+constexpr uint32_t kBlankLine[kLineSize / 4]{0x11, 0x22, 0x33, 0x44};
+
+}  // namespace
+
+TEST(SlotsStartAsBlankLines) {
+  LineRing<4> ring;
+  ring.Init(kBlankLine, kLineSize);
+  for (uint32_t seq = 0; seq < 4; ++seq) {
+    CHECK(memcmp(*ring.SlotPtr(seq), kBlankLine, kLineSize) == 0);
+  }
+}
+
+TEST(ProducerRunsAtMostDepthLinesAhead) {
+  LineRing<4> ring;
+  ring.Init(kBlankLine, kLineSize);
+  for (int i = 0; i < 4; ++i) {
+    CHECK(ring.CanProduce());
+    ring.Produce();
+  }
+  CHECK(!ring.CanProduce());
+  CHECK(ring.IsProduced(3));
+  CHECK(!ring.IsProduced(4));
+
+  // The DMA reads line 2, so lines 0 and 1 are released; the slot of line 2 stays taken.
+  ring.ReleaseBefore(2);
+  CHECK(ring.CanProduce());
+  CHECK(ring.ProducerSlot() == *ring.SlotPtr(0));
+  ring.Produce();
+  ring.Produce();
+  CHECK(!ring.CanProduce());
+  CHECK(ring.ProducerSlot() == *ring.SlotPtr(2));
+  CHECK(!ring.IsAllReleased());
+}
+
+TEST(LateLinesAreSkipped) {
+  LineRing<2> ring;
+  ring.Init(kBlankLine, kLineSize);
+  ring.Produce();
+  CHECK_EQ(ring.SkipReleased(), 0u);
+
+  // The consumer has gone past lines 1 to 4, which were not produced in time.
+  ring.ReleaseBefore(5);
+  CHECK(ring.IsAllReleased());
+  CHECK_EQ(ring.SkipReleased(), 4u);
+  CHECK_EQ(ring.produced(), 5u);
+  CHECK(ring.CanProduce());
+  CHECK(ring.ProducerSlot() == *ring.SlotPtr(5));
+}
+
+// The producer and the consumer on two threads, like on the two cores: each line the consumer
+// takes holds the words of its own sequence number, and is not overwritten while it is read.
+TEST(ProducerAndConsumerOnTwoThreads) {
+  constexpr uint32_t kLineCount = 20'000;
+  LineRing<4> ring;
+  ring.Init(kBlankLine, kLineSize);
+  std::atomic<bool> is_done = false;
+
+  std::thread producer([&ring, &is_done]() {
+    while (!is_done.load(std::memory_order_relaxed)) {
+      ring.SkipReleased();
+      if (!ring.CanProduce()) {
+        std::this_thread::yield();
+        continue;
+      }
+      const uint32_t seq = ring.produced();
+      uint32_t* const slot = ring.ProducerSlot();
+      for (int i = 0; i < kLineSize / 4; ++i) {
+        slot[i] = seq;
+      }
+      ring.Produce();
+    }
+  });
+
+  uint32_t shown_line_count = 0;
+  for (uint32_t seq = 0; seq < kLineCount; ++seq) {
+    // Waits a little for the line, like the beam for the line period, then shows it as late.
+    for (int i = 0; i < 100 && !ring.IsProduced(seq); ++i) {
+      std::this_thread::yield();
+    }
+    if (ring.IsProduced(seq)) {
+      ++shown_line_count;
+      const uint32_t* const slot = *ring.SlotPtr(seq);
+      for (int i = 0; i < kLineSize / 4; ++i) {
+        if (!CHECK_EQ(slot[i], seq)) {
+          break;
+        }
+      }
+      std::this_thread::yield();  // Let the producer run ahead, as the DMA reads the line.
+      if (!CHECK_EQ(slot[kLineSize / 4 - 1], seq)) {
+        break;
+      }
+    }
+    ring.ReleaseBefore(seq);
+  }
+  is_done.store(true, std::memory_order_relaxed);
+  producer.join();
+  CHECK(shown_line_count > kLineCount / 2);
+}
@@ -0,0 +1,264 @@
+#include "pixel_repetition.h"
+
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+// Runs pio_vga_pixels and pio_vga_nibbles of src/programs.pio, with the pixel repetition added,
+// on a model of a PIO state machine, and checks the pins they drive, cycle by cycle.
+
+namespace {
+
+struct Program {
+  std::vector<uint16_t> instructions;
+  std::map<std::string, uint> labels;
+  uint wrap_target = 0;
+  uint wrap = 0;  // The last instruction before jumping to wrap_target.
+};
+
+// Assembles the named program of programs.pio, knowing only the instructions of the pixel
+// programs; the encodings are of the RP2040 datasheet (3.4), with no side-set.
+Program Assemble(const std::string& program_name) {
+  std::ifstream file(PROGRAMS_PIO_PATH);
+  CHECK(file.is_open());
+  Program program;
+  std::vector<std::pair<uint, std::string>> jumps;  // The index of the jmp, and its label.
+  bool is_in_program = false;
+  for (std::string line; std::getline(file, line);) {
+    line = line.substr(0, line.find(';'));
+    std::istringstream words(line);
+    std::string word;
+    if (!(words >> word)) {
+      continue;
+    }
+    if (word == ".program") {
+      words >> word;
+      is_in_program = (word == program_name);
+      continue;
+    }
+    if (!is_in_program) {
+      continue;
+    }
+    const uint index = program.instructions.size();
+    if (word == ".wrap_target") {
+      program.wrap_target = index;
+      continue;
+    }
+    if (word == ".wrap") {
+      program.wrap = index - 1;
+      continue;
+    }
+    if (word == "public") {
+      words >> word;
+    }
+    if (word.back() == ':') {
+      program.labels[word.substr(0, word.size() - 1)] = index;
+      continue;
+    }
+    std::string operands;
+    std::getline(words, operands);
+    operands.erase(0, operands.find_first_not_of(' '));
+    operands.erase(operands.find_last_not_of(' ') + 1);
+
+    uint16_t instruction = 0;
+    if (word == "mov") {
+      static const std::map<std::string, uint16_t> kMovs{
+          {"pins, null", 0b101'00000'000'00'011},
+          {"x, y", 0b101'00000'001'00'010},
+          {"x, isr", 0b101'00000'001'00'110},
+      };
+      CHECK(kMovs.contains(operands));
+      instruction = kMovs.contains(operands) ? kMovs.at(operands) : 0;
+    } else if (word == "wait") {
+      unsigned irq = 0;
+      CHECK(sscanf(operands.c_str(), "1 irq %u", &irq) == 1);
+      instruction = 0b001'00000'1'10'00000 | irq;
+    } else if (word == "out") {
+      unsigned bit_count = 0;
+      CHECK(sscanf(operands.c_str(), "pins, %u", &bit_count) == 1);
+      instruction = 0b011'00000'000'00000 | (bit_count % 32);
+    } else if (word == "jmp") {
+      CHECK(operands.starts_with("x-- "));
+      jumps.push_back({index, operands.substr(4)});
+      instruction = 0b000'00000'010'00000;
+    } else {
+      CHECK_EQ(word, "a known instruction");
+    }
+    program.instructions.push_back(instruction);
+  }
+  for (const auto& [index, label]: jumps) {
+    CHECK(program.labels.contains(label));
+    program.instructions[index] |= program.labels[label];
+  }
+  CHECK(!program.instructions.empty());
+  return program;
+}
+
+// A state machine running the instructions assembled above, one Step() per cycle. The OSR shifts
+// right, with autopull at 32 bits, as configured by init_pio_timing() in main.cpp.
+class StateMachine {
+ public:
+  StateMachine(const Program& program): program_(program) {}
+
+  std::deque<uint32_t> tx_fifo;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t isr = 0;
+  uint32_t pins = 0xFF;  // Not driven yet.
+  bool irq_flags[8]{};
+
+  void Step() {
+    if (delay_ > 0) {
+      --delay_;
+      return;
+    }
+    const uint16_t instruction = program_.instructions[pc_];
+    const uint delay = (instruction >> 8) & 0x1F;
+    uint next_pc = (pc_ == program_.wrap) ? program_.wrap_target : pc_ + 1;
+    switch (instruction >> 13) {
+      case 0b000: {  // jmp x--
+        if (x-- != 0) {
+          next_pc = instruction & 0x1F;
+        }
+      } break;
+      case 0b001: {  // wait 1 irq
+        const uint irq = instruction & 0x7;
+        if (!irq_flags[irq]) {
+          return;  // Stalls, with no delay.
+        }
+        irq_flags[irq] = false;
+      } break;
+      case 0b011: {  // out pins
+        const int bit_count = ((instruction & 0x1F) == 0) ? 32 : (instruction & 0x1F);
+        if (osr_shift_count_ == 32) {
+          if (tx_fifo.empty()) {
+            return;  // Stalls.
+          }
+          osr_ = tx_fifo.front();
+          tx_fifo.pop_front();
+          osr_shift_count_ = 0;
+        }
+        pins = osr_ & ((1u << bit_count) - 1);
+        osr_ >>= bit_count;
+        osr_shift_count_ += bit_count;
+      } break;
+      case 0b101: {  // mov
+        const uint source = instruction & 0x7;
+        const uint32_t value = (source == 0b010) ? y : (source == 0b110) ? isr : 0;
+        if (((instruction >> 5) & 0x7) == 0b000) {
+          pins = value;
+        } else {
+          x = value;
+        }
+      } break;
+      default: {
+        CHECK_EQ(instruction, 0);  // Not assembled above.
+      } break;
+    }
+    pc_ = next_pc;
+    delay_ = delay;
+  }
+
+ private:
+  const Program& program_;
+  uint pc_ = 0;
+  int delay_ = 0;
+  uint32_t osr_ = 0;
+  int osr_shift_count_ = 32;  // Emptied by init_pio_timing().
+};
+
+// The pin levels of the given number of cycles, from the one after the state machine takes
+// IRQ 5, as raised by pio_vga_vsync at the start of the image area.
+std::vector<uint32_t> RunLine(StateMachine& state_machine, int cycle_count) {
+  for (int i = 0; i < 10; ++i) {
+    state_machine.Step();  // Into the wait.
+  }
+  state_machine.irq_flags[5] = true;
+  while (state_machine.irq_flags[5]) {
+    state_machine.Step();
+  }
+  std::vector<uint32_t> pins;
+  for (int i = 0; i < cycle_count; ++i) {
+    state_machine.Step();
+    pins.push_back(state_machine.pins);
+  }
+  return pins;
+}
+
+// The expected pin levels: each pixel for 2 * h_scale cycles, then black.
+std::vector<uint32_t> ExpectedPins(
+    const std::vector<uint32_t>& pixels, int h_scale, int begin, int cycle_count) {
+  std::vector<uint32_t> pins(cycle_count, 0);
+  for (int i = 0; i < (int) pixels.size(); ++i) {
+    for (int cycle = 0; cycle < 2 * h_scale; ++cycle) {
+      pins[begin + i * 2 * h_scale + cycle] = pixels[i];
+    }
+  }
+  return pins;
+}
+
+}  // namespace
+
+TEST(PixelsAreRepeatedAtTheNativePixelClock) {
+  const Program program = Assemble("pio_vga_pixels");
+  for (const int h_scale: {1, 2, 3, 4, 32}) {
+    Program repeating_program = program;
+    add_pixel_repetition(
+        repeating_program.instructions.data(), program.labels.at("pixel"), h_scale);
+
+    StateMachine state_machine(repeating_program);
+    constexpr int kPixelCount = 12;  // 3 FIFO words of 4 GPIO bytes.
+    state_machine.y = kPixelCount - 1;  // As loaded by init_pio_timing().
+    std::vector<uint32_t> pixels;
+    for (int i = 0; i < kPixelCount; ++i) {
+      pixels.push_back(0x10 + i);
+    }
+    for (int word = 0; word < kPixelCount / 4; ++word) {
+      state_machine.tx_fifo.push_back(pixels[word * 4] | (pixels[word * 4 + 1] << 8)
+          | (pixels[word * 4 + 2] << 16) | (pixels[word * 4 + 3] << 24));
+    }
+
+    const int cycle_count = kPixelCount * 2 * h_scale + 8;
+    const std::vector<uint32_t> pins = RunLine(state_machine, cycle_count);
+    if (!CHECK(pins == ExpectedPins(pixels, h_scale, /*begin*/ 0, cycle_count))) {
+      printf("  With h_scale %d\n", h_scale);
+    }
+    CHECK(state_machine.tx_fifo.empty());
+  }
+}
+
+TEST(NibblesAreRepeatedAfterTheMargin) {
+  const Program program = Assemble("pio_vga_nibbles");
+  for (const int h_scale: {1, 2, 3}) {
+    Program repeating_program = program;
+    add_pixel_repetition(
+        repeating_program.instructions.data(), program.labels.at("pixel"), h_scale);
+
+    StateMachine state_machine(repeating_program);
+    constexpr int kPixelCount = 16;  // 2 FIFO words of 8 Vram pixels.
+    constexpr int kMarginPx = 5;
+    state_machine.y = kPixelCount - 1;
+    state_machine.isr = kMarginPx * h_scale * 2;  // As loaded by init_pio_timing().
+    const uint32_t words[]{0x7654'3210, 0xFEDC'BA98};
+    std::vector<uint32_t> pixels;
+    for (const uint32_t word: words) {
+      state_machine.tx_fifo.push_back(word);
+      for (int i = 0; i < 8; ++i) {
+        pixels.push_back((word >> (i * 4)) & 0xF);
+      }
+    }
+
+    // The margin loop takes ISR + 1 cycles, then `mov x, y` one more.
+    const int begin = state_machine.isr + 2;
+    const int cycle_count = begin + kPixelCount * 2 * h_scale + 8;
+    const std::vector<uint32_t> pins = RunLine(state_machine, cycle_count);
+    if (!CHECK(pins == ExpectedPins(pixels, h_scale, begin, cycle_count))) {
+      printf("  With h_scale %d\n", h_scale);
+    }
+  }
+}
@@ -0,0 +1,87 @@
+#include "scanout_geometry.h"
+
+#include <vector>
+
+#include "test.h"
+
+// Checks the word operations of ScanoutGeometry::TransformLine() against a pixel by pixel
+// reference, and the line order of ScanoutGeometry::SourceLine().
+
+namespace {
+
+// The 4-bit pixel x of the line bytes; the even pixel is the low nibble.
+int GetPixel(const uint8_t* bytes, int x) {
+  return (bytes[x / 2] >> (x % 2 * 4)) & 0x0F;
+}
+
+std::vector<uint32_t> MakeLine(int word_count) {
+  std::vector<uint32_t> words(word_count);
+  uint32_t random = 1;
+  for (uint32_t& word: words) {
+    random = random * 1103515245 + 12345;
+    word = random ^ (random << 16);
+  }
+  return words;
+}
+
+// Returns false after logging the first wrong pixel.
+bool CheckTransformLine(const std::vector<uint32_t>& words, const ScanoutGeometry& geometry) {
+  const int width = (int) words.size() * 8;
+  const uint8_t* const bytes = (const uint8_t*) words.data();
+  std::vector<uint32_t> dest(words.size());
+  geometry.TransformLine(dest.data(), {bytes, (int) words.size() * 4});
+
+  for (int x = 0; x < width; ++x) {
+    const int scrolled_x = (x + (int) geometry.x_offset) % width;
+    const int source_x = geometry.is_h_mirrored ? width - 1 - scrolled_x : scrolled_x;
+    if (!CHECK_EQ(GetPixel((const uint8_t*) dest.data(), x), GetPixel(bytes, source_x))) {
+      printf("  Width %d, x_offset %d, mirrored %d: pixel %d\n",
+          width, (int) geometry.x_offset, (int) geometry.is_h_mirrored, x);
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(TransformLineMatchesThePixels) {
+  // A line of 320 pixels, a single word, and a width which is not a power of 2.
+  for (const int word_count: {40, 1, 3}) {
+    const std::vector<uint32_t> words = MakeLine(word_count);
+    // All the offsets which fit the field, wrapping around the line.
+    for (int x_offset = 0; x_offset < (1 << 11); ++x_offset) {
+      for (const bool is_h_mirrored: {false, true}) {
+        ScanoutGeometry geometry;
+        geometry.x_offset = x_offset;
+        geometry.is_h_mirrored = is_h_mirrored;
+        if (!CheckTransformLine(words, geometry)) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+TEST(SourceLinesArePermuted) {
+  constexpr int kHeight = 200;
+  for (int y_offset = 0; y_offset < kHeight; ++y_offset) {
+    for (const bool is_v_flipped: {false, true}) {
+      ScanoutGeometry geometry;
+      geometry.y_offset = y_offset;
+      geometry.is_v_flipped = is_v_flipped;
+      std::vector<bool> is_shown(kHeight);
+      for (int y = 0; y < kHeight; ++y) {
+        const int source_y = geometry.SourceLine(y, kHeight);
+        // The line y_offset of the flipped picture comes first.
+        const int expected_y = (y + y_offset) % kHeight;
+        if (!CHECK_EQ(source_y, is_v_flipped ? kHeight - 1 - expected_y : expected_y)
+            || !CHECK(!is_shown[source_y])) {
+          printf("  y_offset %d, flipped %d: line %d\n", y_offset, is_v_flipped, y);
+          return;
+        }
+        is_shown[source_y] = true;
+      }
+    }
+  }
+}
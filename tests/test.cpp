@@ -0,0 +1,66 @@
+#include "test.h"
+
+#include <vector>
+
+#include "debug.h"
+
+namespace test {
+
+namespace {
+
+struct Test {
+  const char* name;
+  TestFunc func;
+};
+
+std::vector<Test>& tests() {
+  static std::vector<Test> tests;  // Constructed on the first use, by any static initializer.
+  return tests;
+}
+
+int failure_count = 0;
+
+}  // namespace
+
+bool RegisterTest(const char* name, TestFunc func) {
+  tests().push_back({name, func});
+  return true;
+}
+
+void CheckFailed(const char* file, int line, const std::string& message) {
+  printf("FAILED at %s:%d: %s\n", file, line, message.c_str());
+  ++failure_count;
+}
+
+}  // namespace test
+
+// The assertion failure handlers of debug.h, which debug.cpp defines for the device.
+namespace debug::detail {
+
+void PrintBriefAssertionFailureMessage(const char* const /*file_basename*/, int /*line*/) {}
+
+bool AssertFailed(const char* condition_str, const char* file_basename, int line,
+    const char* /*fmt*/, ...) {
+  test::CheckFailed(file_basename, line, std::string("ASSERT(") + condition_str + ")");
+  return false;
+}
+
+bool AssertCmpFailed(const char* lhs_str, const char* op_str, const char* rhs_str,
+    const char* lhs_val, const char* rhs_val, const char* file_basename, int line,
+    const char* /*fmt*/, ...) {
+  test::CheckFailed(file_basename, line, nx::kit::utils::format(
+      "ASSERT_CMP(%s %s %s)\n  Actual values: %s %s %s",
+      lhs_str, op_str, rhs_str, lhs_val, op_str, rhs_val));
+  return false;
+}
+
+}  // namespace debug::detail
+
+int main() {
+  for (const test::Test& test: test::tests()) {
+    const int failure_count = test::failure_count;
+    test.func();
+    printf("%s %s\n", (test::failure_count == failure_count) ? "OK    " : "FAILED", test.name);
+  }
+  return (test::failure_count == 0) ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+
+#include "nx/kit/utils.h"
+
+// A minimal framework for the host tests. TEST() defines a test function, which main() in
+// test.cpp runs; the checks log their failures and let the test go on, and the executable fails
+// if any check failed. A failed ASSERT() of the code under test counts as a failed check.
+
+namespace test {
+
+using TestFunc = void (*)();
+
+// Called by TEST() at static initialization.
+bool RegisterTest(const char* name, TestFunc func);
+
+void CheckFailed(const char* file, int line, const std::string& message);
+
+}  // namespace test
+
+#define TEST(NAME) \
+  static void NAME(); \
+  [[maybe_unused]] static const bool NAME##_is_registered = ::test::RegisterTest(#NAME, NAME); \
+  static void NAME()
+
+#define CHECK(CONDITION) ( \
+  (CONDITION) ? true : (::test::CheckFailed(__FILE_NAME__, __LINE__, #CONDITION), false) \
+)
+
+// Logs the values of both sides on failure.
+#define CHECK_EQ(LHS, RHS) ( \
+  ((LHS) == (RHS)) ? true : (::test::CheckFailed(__FILE_NAME__, __LINE__, \
+      std::string(#LHS " == " #RHS "\n  Actual values: ") + nx::kit::utils::toString(LHS) \
+          + " == " + nx::kit::utils::toString(RHS)), false) \
+)
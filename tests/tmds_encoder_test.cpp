@@ -0,0 +1,187 @@
+#include "tmds_encoder.h"
+
+#include <stdlib.h>
+#include <vector>
+
+#include "test.h"
+
+// Checks TmdsEncoder against the DVI 1.0 rules for the symbols, and decodes the words of the lines
+// it makes back to the symbols of the data lanes, and those to the levels of the colors.
+
+namespace {
+
+// The layout of kVideoModeVga640x480x60 in main.cpp; only these fields are used by the encoder.
+constexpr VideoMode kVideoMode{
+    .h_visible_area = 640,
+    .whole_line = 800,
+    .h_front_porch = 16,
+    .h_sync_pulse = 96,
+    .h_back_porch = 48,
+    .h_scale = TmdsEncoder::kPixelRepetition,
+};
+constexpr int kImageBegin = (640 / TmdsEncoder::kPixelRepetition - Vram::kWidthPx) / 2
+    * TmdsEncoder::kPixelRepetition;
+
+// The control symbols by C1 C0, per DVI 1.0 (3.3.3).
+constexpr uint16_t kControlSymbols[4]{0b1101010100, 0b0010101011, 0b0101010100, 0b1010101011};
+
+int CountOnes(uint16_t symbol) {
+  return __builtin_popcount(symbol);
+}
+
+int CountTransitions(uint16_t symbol, int bits) {
+  return CountOnes((symbol ^ (symbol >> 1)) & ((1 << (bits - 1)) - 1));
+}
+
+bool IsControlSymbol(uint16_t symbol) {
+  for (const uint16_t control_symbol: kControlSymbols) {
+    if (symbol == control_symbol) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The symbol of the lane in the pixel of the line, from the differential pairs of the words;
+// fails the test if a pair does not have opposite levels.
+uint16_t ExtractSymbol(const std::vector<uint32_t>& line, int x, int lane) {
+  uint16_t symbol = 0;
+  for (int bit_time = 0; bit_time < TmdsEncoder::kSymbolBits; ++bit_time) {
+    const uint32_t word = line[x * TmdsEncoder::kWordsPerPixel + bit_time / 5];
+    const uint32_t pair = (word >> ((bit_time % 5) * 6 + lane * 2)) & 0b11;
+    CHECK(pair == 0b01 || pair == 0b10);
+    symbol |= (pair >> 1) << bit_time;
+  }
+  return symbol;
+}
+
+std::vector<uint8_t> MakeColorBarsLine() {
+  constexpr int kBarWidthPx = Vram::kWidthPx / Vram::kColorCount;
+  std::vector<uint8_t> vram_line(Vram::kLineSize);
+  for (int x = 0; x < Vram::kWidthPx; x += 2) {
+    const uint8_t color = x / kBarWidthPx;
+    vram_line[x / 2] = color | (color << 4);
+  }
+  return vram_line;
+}
+
+// The level of the lane (0 is blue, 1 is green and 2 is red) for the color, like the RGB
+// outputs: 2/3 of the full level for a normal color, the full level for a bright one.
+int LaneLevel(int color, int lane) {
+  constexpr int kLaneColorBits[3]{Vram::kBlue, Vram::kGreen, Vram::kRed};
+  return (color & kLaneColorBits[lane]) ? ((color & Vram::kBright) ? 255 : 255 * 2 / 3) : 0;
+}
+
+}  // namespace
+
+TEST(SymbolsDecodeBackAtAnyDisparity) {
+  for (int initial_disparity = -8; initial_disparity <= 8; initial_disparity += 2) {
+    for (int value = 0; value < 256; ++value) {
+      int disparity = initial_disparity;
+      const uint16_t symbol = TmdsEncoder::EncodeSymbol((uint8_t) value, disparity);
+      // The running disparity counts the ones over the zeros of the symbols sent.
+      if (!CHECK(symbol < (1 << TmdsEncoder::kSymbolBits))
+          || !CHECK_EQ(TmdsEncoder::DecodeSymbol(symbol), value)
+          || !CHECK_EQ(disparity - initial_disparity,
+              2 * CountOnes(symbol) - TmdsEncoder::kSymbolBits)
+          || !CHECK(!IsControlSymbol(symbol))
+          // The transition minimization leaves at most 4 transitions in the 8 data bits.
+          || !CHECK(CountTransitions(symbol, 8) <= 4)) {
+        printf("  Value %d at disparity %d: symbol 0x%03X\n", value, initial_disparity, symbol);
+      }
+    }
+  }
+}
+
+// Symbols worked out by hand per the encoding algorithm of DVI 1.0 (3.3.2), from disparity 0.
+TEST(SymbolsFollowTheDviAlgorithm) {
+  struct Example {
+    uint8_t value;
+    uint16_t symbol;
+    int disparity;
+  };
+  constexpr Example kExamples[]{
+      {0x00, 0b01'0000'0000, -8},  // XOR, not inverted.
+      {0xFF, 0b10'0000'0000, -8},  // XNOR, inverted.
+      {0x1E, 0b10'0101'1111, 4},  // 4 ones and bit 0 is 0: XNOR, inverted.
+      {0x1F, 0b10'1010'0000, -4},  // 5 ones: XNOR, inverted.
+  };
+  for (const Example& example: kExamples) {
+    int disparity = 0;
+    const uint16_t symbol = TmdsEncoder::EncodeSymbol(example.value, disparity);
+    if (!CHECK_EQ(symbol, example.symbol)
+        || !CHECK_EQ(disparity, example.disparity)) {
+      printf("  Value 0x%02X\n", example.value);
+    }
+  }
+}
+
+TEST(RunningDisparityStaysBounded) {
+  int disparity = 0;
+  uint32_t random = 1;
+  for (int i = 0; i < 100000; ++i) {
+    // Runs of the most unbalanced values among pseudo-random ones.
+    random = random * 1103515245 + 12345;
+    const uint8_t value = (i % 1000 < 100) ? 0x00 : (i % 1000 < 200) ? 0xFF : (random >> 16);
+    TmdsEncoder::EncodeSymbol(value, disparity);
+    // From 0, a symbol moves the disparity by 8 at most; otherwise it moves it toward 0, by 10
+    // at most, so it never gets past 8 either way.
+    if (!CHECK(abs(disparity) <= 8)) {
+      printf("  Symbol %d: disparity %d\n", i, disparity);
+      return;
+    }
+  }
+}
+
+TEST(LineCarriesTheLevelsOfTheColors) {
+  TmdsEncoder encoder;
+  encoder.Init(kVideoMode, kImageBegin, /*is_hsync_negative*/ true, /*is_vsync_negative*/ true);
+  std::vector<uint32_t> line(kVideoMode.whole_line * TmdsEncoder::kWordsPerPixel);
+  encoder.EncodeBlankLine(line.data(), /*is_vsync*/ false, /*is_video_period*/ true);
+  const std::vector<uint8_t> vram_line = MakeColorBarsLine();
+  // In two parts, like the cores do.
+  const int half_size = Vram::kLineSize / 2;
+  encoder.EncodeLine(line.data(), {vram_line.data(), half_size}, /*first_vram_byte*/ 0);
+  encoder.EncodeLine(
+      line.data(), {vram_line.data() + half_size, Vram::kLineSize - half_size}, half_size);
+
+  for (int x = 0; x < kVideoMode.h_visible_area; ++x) {
+    const int vram_x = (x - kImageBegin) / TmdsEncoder::kPixelRepetition;
+    const bool is_image = x >= kImageBegin && vram_x < Vram::kWidthPx;
+    const int color = is_image ? vram_line[vram_x / 2] >> (vram_x % 2 * 4) & 0x0F : Vram::kBlack;
+    for (int lane = 0; lane < 3; ++lane) {
+      const uint16_t symbol = ExtractSymbol(line, x, lane);
+      // Balanced, so that the pixel does not depend on the ones before it; the nearest balanced
+      // levels are within 16 steps, e.g. 16 for black, which is the black of limited-range video.
+      const int level = TmdsEncoder::DecodeSymbol(symbol);
+      if (!CHECK_EQ(CountOnes(symbol), TmdsEncoder::kSymbolBits / 2)
+          || !CHECK(abs(level - LaneLevel(color, lane)) <= 16)) {
+        printf("  Pixel %d, lane %d, color %d: symbol 0x%03X, level %d\n",
+            x, lane, color, symbol, level);
+        return;
+      }
+    }
+  }
+}
+
+TEST(BlankLineCarriesTheSyncs) {
+  TmdsEncoder encoder;
+  encoder.Init(kVideoMode, kImageBegin, /*is_hsync_negative*/ true, /*is_vsync_negative*/ true);
+  std::vector<uint32_t> line(kVideoMode.whole_line * TmdsEncoder::kWordsPerPixel);
+  const int h_sync_begin = kVideoMode.h_visible_area + kVideoMode.h_front_porch;
+  const int h_sync_end = h_sync_begin + kVideoMode.h_sync_pulse;
+  for (const bool is_vsync: {false, true}) {
+    encoder.EncodeBlankLine(line.data(), is_vsync, /*is_video_period*/ false);
+    for (int x = 0; x < kVideoMode.whole_line; ++x) {
+      // Negative syncs: the control bits are 1 when idle; C0 is H-sync and C1 is V-sync.
+      const bool is_hsync = x >= h_sync_begin && x < h_sync_end;
+      const int control_bits = (is_vsync ? 0 : 0b10) | (is_hsync ? 0 : 0b01);
+      if (!CHECK_EQ(ExtractSymbol(line, x, 0), kControlSymbols[control_bits])
+          || !CHECK_EQ(ExtractSymbol(line, x, 1), kControlSymbols[0])
+          || !CHECK_EQ(ExtractSymbol(line, x, 2), kControlSymbols[0])) {
+        printf("  Pixel %d, V-sync %d\n", x, is_vsync);
+        return;
+      }
+    }
+  }
+}